@@ -5,9 +5,6 @@
 #include <fstream>
 #include <iomanip>
 #include <map>
-#include <set>
-#include <stack>
-#include <queue>
 // #include <algorithm> // Removed
 #include <cstdlib>
 #include <ctime>
@@ -15,289 +12,768 @@
 #include <iostream>
 #include <string>
 #include <array> // Added to store performance data arrays
+#include <random>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include "Profiler.h"
 
 using namespace std;
 
+// Card glyphs are 6 rows of 7 characters
+const int CARD_ROWS = 6;
+const int CARD_WIDTH = 7;
+
 // Utility functions
-void getCardGraphic(int card, char cardLines[6][7]);
-void getHiddenCardGraphic(char cardLines[6][7]);
+void getCardGraphic(int card, char cardLines[CARD_ROWS][CARD_WIDTH + 1]);
+void getHiddenCardGraphic(char cardLines[CARD_ROWS][CARD_WIDTH + 1]);
+
+// Card counting system: the tag added to the running count per rank
+struct CountingSystem {
+    const char* name;
+    int tags[14];       // Index 1-13 (ace to king)
+};
+
+extern const CountingSystem HI_LO;
+extern const CountingSystem KNOCK_OUT;
+extern const CountingSystem OMEGA_II;
+extern const CountingSystem ZEN_COUNT;
 
-// AVL Tree for player's hand
-class AVLTree {
+// Returns nullptr for an unknown system name
+const CountingSystem* findCountingSystem(const std::string& name);
+
+// Random stream
+/* xoshiro256** (Blackman and Vigna): 256 bits of state, fast and small
+   enough that every deck owns one. A 64-bit seed is expanded with
+   SplitMix64. jump() advances the stream by 2^128 draws and longJump() by
+   2^192, so one seed yields non-overlapping streams for any number of
+   workers. bounded() is Lemire's multiply-shift draw, which rejects the
+   few values that would make r % n biased. */
+class Xoshiro256 {
 private:
-    struct Node {
-        int key;
-        Node* left;
-        Node* right;
-        int height;
-        Node(int k) : key(k), left(nullptr), right(nullptr), height(1) {}
-    };
+    std::uint64_t s[4];
 
-    Node* root;     // Tree root
-    
-    // Node insertion function
-    Node* insertNode(Node* node, int key) {
-        if (!node) return new Node(key);
-        if (key < node->key) {
-            node->left = insertNode(node->left, key);
-        } else {
-            node->right = insertNode(node->right, key);
-        }
-        updateHeight(node);
-        return balance(node);
-    }
-
-    // Height update
-    void updateHeight(Node* node) {
-        int hl = (node->left ? node->left->height : 0);
-        int hr = (node->right ? node->right->height : 0);
-        node->height = (hl > hr ? hl : hr) + 1;
-    }
-
-    // Balancing factor
-    int getBalanceFactor(Node* node) {
-        if (!node) return 0;
-        int hl = (node->left ? node->left->height : 0);
-        int hr = (node->right ? node->right->height : 0);
-        return hl - hr;
-    }
-
-    // Right rotation
-    Node* rotateRight(Node* y) {
-        Node* x = y->left;
-        Node* T2 = x->right;
-        x->right = y;
-        y->left = T2;
-        updateHeight(y);
-        updateHeight(x);
-        return x;
-    }
-
-    // Left rotation
-    Node* rotateLeft(Node* x) {
-        Node* y = x->right;
-        Node* T2 = y->left;
-        y->left = x;
-        x->right = T2;
-        updateHeight(x);
-        updateHeight(y);
-        return y;
-    }
-
-    Node* balance(Node* node) {
-        int bf = getBalanceFactor(node);
-        if (bf > 1) {
-            if (getBalanceFactor(node->left) < 0) {
-                node->left = rotateLeft(node->left);
+    static std::uint64_t rotl(std::uint64_t x, int k) {
+        return (x << k) | (x >> (64 - k));
+    }
+
+    void jumpBy(const std::uint64_t polynomial[4]) {
+        std::uint64_t t[4] = { 0, 0, 0, 0 };
+        for (int i = 0; i < 4; i++) {
+            for (int b = 0; b < 64; b++) {
+                if (polynomial[i] & (std::uint64_t(1) << b)) {
+                    for (int j = 0; j < 4; j++) {
+                        t[j] ^= s[j];
+                    }
+                }
+                next();
             }
-            return rotateRight(node);
-        } else if (bf < -1) {
-            if (getBalanceFactor(node->right) > 0) {
-                node->right = rotateRight(node->right);
+        }
+        for (int j = 0; j < 4; j++) {
+            s[j] = t[j];
+        }
+    }
+
+public:
+    explicit Xoshiro256(std::uint64_t seed = 0) {
+        this->seed(seed);
+    }
+
+    static std::uint64_t splitMix64(std::uint64_t& state) {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    void seed(std::uint64_t seed) {
+        for (int i = 0; i < 4; i++) {
+            s[i] = splitMix64(seed);
+        }
+    }
+
+    std::uint64_t next() {
+        std::uint64_t result = rotl(s[1] * 5, 7) * 9;
+        std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // Uniform in [0, n), n > 0
+    std::uint32_t bounded(std::uint32_t n) {
+        std::uint64_t m = (next() >> 32) * n;
+        std::uint32_t low = static_cast<std::uint32_t>(m);
+        if (low < n) {
+            std::uint32_t threshold = static_cast<std::uint32_t>(-n) % n;
+            while (low < threshold) {
+                m = (next() >> 32) * n;
+                low = static_cast<std::uint32_t>(m);
             }
-            return rotateLeft(node);
         }
-        return node;
+        return static_cast<std::uint32_t>(m >> 32);
+    }
+
+    void jump() {
+        static const std::uint64_t JUMP[4] = { 0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull,
+                                               0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull };
+        jumpBy(JUMP);
+    }
+
+    void longJump() {
+        static const std::uint64_t LONG_JUMP[4] = { 0x76E15D3EFEFDCBBFull, 0xC5004E441C522FB3ull,
+                                                    0x77710069854EE241ull, 0x39109BB02ACBE635ull };
+        jumpBy(LONG_JUMP);
+    }
+};
+
+// A seed that differs from run to run, for when none is given
+std::uint64_t randomSeed();
+
+// Doubling is only offered on two cards totalling hard 9-11 or soft 16-18
+inline bool doubleAllowedOn(int total, bool soft) {
+    if (soft) {
+        return total >= 16 && total <= 18;
+    }
+    return total >= 9 && total <= 11;
+}
+
+// Table rules
+/* A rules class answers every rule question with a static function. The
+   deck and the game are templates over it, so under TableRules each answer
+   is a constant folded into the dealing and playing code, and RuntimeRules
+   gives one build that reads the rules set at startup instead. */
+const int MAX_DECKS = 8;
+
+struct RuleSet {
+    int decks;                  // 1 to MAX_DECKS
+    int penetration;            // Percent of the shoe dealt before the reshuffle
+    bool hitSoft17;             // The house hits soft 17
+    int blackjackPays[2];       // A natural pays [0]:[1]
+    bool doubleAnyTwo;          // Otherwise hard 9-11 and soft 16-18 only
+    bool doubleAfterSplit;
+    bool split;                 // Pairs may be split (once)
+
+    bool operator==(const RuleSet& other) const {
+        return decks == other.decks && penetration == other.penetration && hitSoft17 == other.hitSoft17 &&
+               blackjackPays[0] == other.blackjackPays[0] && blackjackPays[1] == other.blackjackPays[1] &&
+               doubleAnyTwo == other.doubleAnyTwo && doubleAfterSplit == other.doubleAfterSplit &&
+               split == other.split;
+    }
+    bool operator!=(const RuleSet& other) const { return !(*this == other); }
+
+    // Within the bounds every table can be built with
+    bool isValid() const {
+        return decks >= 1 && decks <= MAX_DECKS && penetration >= 10 && penetration <= 95 &&
+               blackjackPays[0] >= 1 && blackjackPays[1] >= 1;
+    }
+
+    bool houseHits(int total, bool soft) const {
+        return total < 17 || (hitSoft17 && total == 17 && soft);
+    }
+};
+
+// e.g. "7 decks, 75% penetration, S17, blackjack 3:2, double 9-11/soft 16-18, DAS"
+std::string describeRules(const RuleSet& rules);
+
+template <int Decks, int Penetration, bool HitSoft17, int BlackjackNum, int BlackjackDen,
+          bool DoubleAnyTwo, bool DoubleAfterSplit, bool Split>
+struct TableRules {
+    static const int SHOE_CAPACITY = 52 * Decks;
+
+    static constexpr int decks() { return Decks; }
+    static constexpr int shoeSize() { return 52 * Decks; }
+    static constexpr int cutCard() { return 52 * Decks * Penetration / 100; }
+
+    static bool houseHits(int total, bool soft) {
+        return total < 17 || (HitSoft17 && total == 17 && soft);
     }
 
-    // Node clearing
-    void clearNode(Node* node) {
-        if (!node) return;
-        clearNode(node->left);
-        clearNode(node->right);
-        delete node;
+    // Winnings on a natural, on top of the returned wager (odd cents rounded down)
+    static long long naturalWinnings(long long wager) {
+        return wager * BlackjackNum / BlackjackDen;
     }
 
-    void inorder(Node* node, int*& arr, int& index) const {
-        if (!node) return;
-        inorder(node->left, arr, index);
-        arr[index++] = node->key;
-        inorder(node->right, arr, index);
+    static bool canDouble(int total, bool soft, bool afterSplit) {
+        return (DoubleAfterSplit || !afterSplit) && (DoubleAnyTwo || doubleAllowedOn(total, soft));
     }
 
-    int getSize(Node* node) const {
-        if (!node) return 0;
-        return 1 + getSize(node->left) + getSize(node->right);
+    static constexpr bool canSplit() { return Split; }
+
+    static constexpr RuleSet ruleSet() {
+        return { Decks, Penetration, HitSoft17, { BlackjackNum, BlackjackDen }, DoubleAnyTwo, DoubleAfterSplit, Split };
+    }
+};
+
+// This table: 7 decks cut at 75%, house stands on soft 17, 3:2, restricted doubles
+typedef TableRules<7, 75, false, 3, 2, false, true, true> StandardRules;
+
+struct RuntimeRules {
+    static const int SHOE_CAPACITY = 52 * MAX_DECKS;
+
+    // Not thread-safe: set before any deck or game is created
+    static RuleSet current;
+
+    static int decks() { return current.decks; }
+    static int shoeSize() { return 52 * current.decks; }
+    static int cutCard() { return 52 * current.decks * current.penetration / 100; }
+
+    static bool houseHits(int total, bool soft) {
+        return current.houseHits(total, soft);
+    }
+
+    static long long naturalWinnings(long long wager) {
+        return wager * current.blackjackPays[0] / current.blackjackPays[1];
+    }
+
+    static bool canDouble(int total, bool soft, bool afterSplit) {
+        return (current.doubleAfterSplit || !afterSplit) && (current.doubleAnyTwo || doubleAllowedOn(total, soft));
+    }
+
+    static bool canSplit() { return current.split; }
+    static RuleSet ruleSet() { return current; }
+};
+
+// Shoe contents and count
+/* Cards left per rank and the running count for the selected counting
+   system, kept up to date as each card is dealt. This is the part of a
+   deck strategies look at, whatever rules the deck was built for. */
+class ShoeCounts {
+protected:
+    int shoeSize;
+    int cardsDealt;             // Dealing cursor and penetration counter
+    int rankCounts[14];         // Cards left per rank (index 1-13)
+
+    // Counting: tags are copied in so the draw path needs a single add
+    const CountingSystem* countingSystem;
+    int countTags[14];
+    int runningCount;
+    int initialRunningCount;    // Non-zero for unbalanced systems such as KO
+
+    explicit ShoeCounts(int shoeSize) : shoeSize(shoeSize), cardsDealt(0), countingSystem(nullptr),
+                                        runningCount(0), initialRunningCount(0) {}
+
+    void resetCounts() {
+        for (int i = 1; i <= 13; ++i) {
+            rankCounts[i] = shoeSize / 13;
+        }
+        rankCounts[0] = 0;
+        cardsDealt = 0;
+        runningCount = initialRunningCount;
     }
 
 public:
-    AVLTree() : root(nullptr) {}
+    int getCardsDealt() const {
+        return cardsDealt;
+    }
 
-    void insert(int key) {
-        root = insertNode(root, key);
+    int getCardsRemaining() const {
+        return shoeSize - cardsDealt;
     }
 
-    void clear() {
-        clearNode(root);
-        root = nullptr;
+    int getRankCount(int rank) const {
+        return rankCounts[rank];
+    }
+
+    const CountingSystem& getCountingSystem() const {
+        return *countingSystem;
+    }
+
+    int getRunningCount() const {
+        return runningCount;
     }
 
-    int getSize() const {
-        return getSize(root);
+    // Running count per deck left in the shoe
+    double getTrueCount() const {
+        return runningCount * 52.0 / (shoeSize - cardsDealt);
     }
 
-    int* toArray(int &sz) const {
-        sz = getSize(root);
-        int* arr = new int[sz];
-        int idx = 0;
-        inorder(root, arr, idx);
-        return arr;
+    void printCardCounts() const {
+        cout << "Current card counts:" << endl;
+        for (int i = 1; i <= 13; ++i) {
+            cout << "Card " << i << ": " << rankCounts[i] << endl;
+        }
     }
+
+    void displayDeckStatus() const {
+        cout << "Deck status:" << endl;
+        cout << "Cards dealt from the shoe: " << cardsDealt << " of " << shoeSize << endl;
+        cout << countingSystem->name << " running count: " << runningCount
+             << ", true count: " << fixed << setprecision(1) << getTrueCount() << endl;
+    }
+};
+
+// A shoe shuffled ahead of time and the deck's stream just after shuffling it
+struct PreparedShoe {
+    unsigned char cards[52 * MAX_DECKS];    // The first shoeSize() cards are used
+    Xoshiro256 streamAfter;
 };
 
 // Class for deck of cards
-/* This class represents a deck of cards composed of 7 decks with 52 cards,
-   this is implemented to simulate a card deck like in the casino, and not
-   just generate random cards. This could even allow for card counting*/
-class CardDeck {
+/* This class represents a shoe of as many 52-card decks as the rules
+   call for, this is implemented to simulate a card deck like in the
+   casino, and not just generate random cards. */
+template <class Rules>
+class BasicCardDeck : public ShoeCounts {
 private:
-    std::map<int, int> cardCounts;
-    std::set<int> usedCards;
-    std::stack<int> returnedCards;
-    // Array for the entire deck
-    int deckArray[364];
+
+    // The shoe, dealt front to back
+    unsigned char shoe[Rules::SHOE_CAPACITY];
+    bool quiet;     // Suppress console messages (headless simulation)
+    Xoshiro256 rng;     // Each deck owns its random stream
+
+    // Shoes shuffled ahead of time, used in order at the next reshuffles
+    const PreparedShoe* preparedShoes;
+    int preparedCount;
 
     void initializeDeck() {
-        cardCounts.clear();
-        for (int i = 1; i <= 13; i++) {
-            cardCounts[i] = 28;
-        }
-        while (!returnedCards.empty()) {
-            returnedCards.pop();
+        fillShoe(shoe, rng);
+        resetCounts();
+    }
+
+    // Fisher-Yates over cards[first, last)
+    static void shuffleCards(unsigned char* cards, int first, int last, Xoshiro256& rng) {
+        for (int n = last - first; n > 1; --n) {
+            int r = first + static_cast<int>(rng.bounded(static_cast<std::uint32_t>(n)));
+            unsigned char temp = cards[r];
+            cards[r] = cards[first + n - 1];
+            cards[first + n - 1] = temp;
         }
-        usedCards.clear();
+    }
 
-        int index = 0;
+    void shuffleRange(int first, int last) {
+        shuffleCards(shoe, first, last, rng);
+    }
+
+public:
+    // Without a seed every deck gets a fresh one
+    BasicCardDeck() : ShoeCounts(Rules::shoeSize()), quiet(false), rng(randomSeed()),
+                      preparedShoes(nullptr), preparedCount(0) {
+        setCountingSystem(HI_LO);
+        initializeDeck();
+    }
+
+    explicit BasicCardDeck(std::uint64_t seed) : ShoeCounts(Rules::shoeSize()), quiet(false), rng(seed),
+                                                 preparedShoes(nullptr), preparedCount(0) {
+        setCountingSystem(HI_LO);
+        initializeDeck();
+    }
+
+    /* Switch counting systems. Unbalanced systems start below zero
+       (-tag sum per deck for every deck after the first) so the running
+       count reaches the same key value whatever the shoe size. The count
+       restarts from the cards already dealt. */
+    void setCountingSystem(const CountingSystem& system) {
+        countingSystem = &system;
+        int deckSum = 0;
         for (int i = 1; i <= 13; ++i) {
-            for (int j = 0; j < 28; ++j) {
-                deckArray[index++] = i;
-            }
+            countTags[i] = system.tags[i];
+            deckSum += 4 * system.tags[i];
         }
-        
-        // Recursive shuffle new
-        recursiveShuffleDeck(deckArray, 364);
-    }
-
-    // Recursive function definition
-    void recursiveShuffleDeck(int arr[], int n) {
-        if (n <= 1) return;
-        int r = rand() % n;
-        int temp = arr[r];
-        arr[r] = arr[n - 1];
-        arr[n - 1] = temp;
-        recursiveShuffleDeck(arr, n - 1);
-    }
-
-    void reshuffleDeck() {
-        while (!returnedCards.empty()) {
-            int card = returnedCards.top();
-            cardCounts[card]++;
-            returnedCards.pop();
+        countTags[0] = 0;
+        initialRunningCount = -deckSum * (Rules::decks() - 1);
+        runningCount = initialRunningCount;
+        for (int i = 0; i < cardsDealt; ++i) {
+            runningCount += countTags[shoe[i]];
         }
+    }
+
+    // Restart with a fresh shoe drawn from a new stream
+    void reseed(std::uint64_t seed) {
+        rng.seed(seed);
         initializeDeck();
     }
 
-public:
-    CardDeck() {
+    void reseed(const Xoshiro256& stream) {
+        rng = stream;
         initializeDeck();
     }
 
+    // Gather every card and shuffle a new shoe (or take the next prepared one)
+    void reshuffle() {
+        PROFILE_SCOPE(PROFILE_RESHUFFLE);
+        if (preparedCount > 0) {
+            memcpy(shoe, preparedShoes->cards, Rules::shoeSize());
+            rng = preparedShoes->streamAfter;
+            preparedShoes++;
+            preparedCount--;
+            resetCounts();
+        } else {
+            initializeDeck();
+        }
+    }
+
+    // A new shoe of every card, shuffled with rng as the deck itself would
+    static void fillShoe(unsigned char* cards, Xoshiro256& rng) {
+        int index = 0;
+        for (int i = 1; i <= 13; ++i) {
+            for (int j = 0; j < 4 * Rules::decks(); ++j) {
+                cards[index++] = static_cast<unsigned char>(i);
+            }
+        }
+        shuffleCards(cards, 0, Rules::shoeSize(), rng);
+    }
+
+    /* Use shoes shuffled elsewhere for the next count reshuffles; they must
+       stay valid until they are used or replaced. Each carries the stream
+       as it was after its shuffle, so the deck deals exactly what it would
+       have shuffled itself. */
+    void usePreparedShoes(const PreparedShoe* shoes, int count) {
+        preparedShoes = shoes;
+        preparedCount = count;
+    }
+
+    void setQuiet(bool q) {
+        quiet = q;
+    }
+
+    // Shuffle the cards that have not been dealt yet
     void shuffleDeck() {
-        recursiveShuffleDeck(deckArray, 364);
-        cout << "Shuffling the deck with recursion..." << endl;
+        shuffleRange(cardsDealt, Rules::shoeSize());
+        if (!quiet) cout << "Shuffling the deck..." << endl;
     }
 
     int drawCard() {
+        PROFILE_SCOPE(PROFILE_DRAW);
         if (needsReshuffling()) {
-            cout << "Reshuffling the deck..." << endl;
-            reshuffleDeck();
+            if (!quiet) cout << "Reshuffling the deck..." << endl;
+            reshuffle();
         }
-        int card;
-        do {
-            card = deckArray[rand() % 364]; 
-        } while (cardCounts[card] == 0);
-        cardCounts[card]--;
-        usedCards.insert(card);
+        int card = shoe[cardsDealt++];
+        rankCounts[card]--;
+        runningCount += countTags[card];
         return card;
     }
-    
-    // map to check if shuffling is needed
+
     bool needsReshuffling() const {
-        int totalCardsUsed = 0;
-        for (std::map<int,int>::const_iterator it = cardCounts.begin(); it != cardCounts.end(); ++it) {
-            totalCardsUsed += (28 - it->second);
-        }
-        return totalCardsUsed >= (52 * 7 * 3 / 4);
+        return cardsDealt >= Rules::cutCard();
     }
+};
 
-    // Return all the card
-    void returnCard(int card) {
-        returnedCards.push(card);
+typedef BasicCardDeck<StandardRules> CardDeck;
+
+/* Bit offset of each rank's count in a hand key. A hand holds at most one
+   card more than fits under 21, so counts never exceed 22 aces, 11 twos,
+   8 threes, 6 fours, 5 fives, 4 sixes or sevens and 3 of anything higher:
+   5, 4, 4, 3, 3, 3, 3 and then 2 bits each, 37 bits in all. */
+constexpr int HAND_KEY_SHIFT[14] = { 0, 0, 5, 9, 13, 16, 19, 22, 25, 27, 29, 31, 33, 35 };
+
+// Hand of cards kept in deal order
+/* Cards are stored inline and the total, soft aces, pair flag and key are
+   updated as each card arrives, so scoring a hand never touches the heap.
+   The key packs the count of each rank, so it is the same for every order
+   of the same cards and different for any other cards. */
+class Hand {
+public:
+    static const int MAX_CARDS = 22;    // 21 aces plus the card that busts
+
+private:
+    unsigned char cards[MAX_CARDS];
+    int count;
+    int total;
+    int softAces;       // Aces still counted as 11
+    bool pair;
+    std::uint64_t key;  // Rank counts packed at HAND_KEY_SHIFT
+
+public:
+    Hand() : count(0), total(0), softAces(0), pair(false), key(0) {}
+
+    void clear() {
+        count = 0;
+        total = 0;
+        softAces = 0;
+        pair = false;
+        key = 0;
     }
 
-    void printCardCounts() const {
-        std::map<int,int>::const_iterator it = cardCounts.begin();
-        cout << "Current card counts:" << endl;
-        for (; it != cardCounts.end(); ++it) {
-            cout << "Card " << it->first << ": " << it->second << endl;
+    void addCard(int card) {
+        cards[count++] = static_cast<unsigned char>(card);
+        key += std::uint64_t(1) << HAND_KEY_SHIFT[card];
+        if (card == 1) {
+            total += 11;
+            softAces++;
+        } else {
+            total += (card > 10 ? 10 : card);
+        }
+        while (total > 21 && softAces > 0) {
+            total -= 10;
+            softAces--;
         }
+        pair = (count == 2 && cards[0] == cards[1]);
     }
 
-    void displayDeckStatus() const {
-        cout << "Deck status:" << endl;
-        cout << "Total unique cards used: " << (int)usedCards.size() << endl;
+    // Insertion sort; the score does not depend on card order
+    void sort() {
+        for (int i = 1; i < count; i++) {
+            unsigned char key = cards[i];
+            int j = i - 1;
+            while (j >= 0 && cards[j] > key) {
+                cards[j + 1] = cards[j];
+                j--;
+            }
+            cards[j + 1] = key;
+        }
     }
+
+    int getTotal() const { return total; }
+    std::uint64_t getKey() const { return key; }
+    int getSize() const { return count; }
+    int getCard(int i) const { return cards[i]; }
+    bool isSoft() const { return softAces > 0; }
+    bool isPair() const { return pair; }
+};
+
+// Table output
+/* A frame (seats, the house and menus) is collected in one reusable buffer
+   and written with a single call when it is flushed, before each read from
+   the keyboard. The buffer keeps its capacity between frames, and cards are
+   copied from glyphs rendered once at startup. A quiet frame drops
+   everything without formatting it. */
+class FrameBuffer {
+private:
+    std::string buffer;
+    bool quiet;
+    std::string* target;    // Where flush sends the frame; the console when null
+
+public:
+    FrameBuffer() : quiet(false), target(nullptr) {}
+
+    void setQuiet(bool q) { quiet = q; }
+    bool isQuiet() const { return quiet; }
+    void setTarget(std::string* out) { target = out; }
+
+    FrameBuffer& operator<<(const char* text);
+    FrameBuffer& operator<<(const std::string& text);
+    FrameBuffer& operator<<(char c);
+    FrameBuffer& operator<<(int value);
+    FrameBuffer& operator<<(double value);     // Money, two decimals
+
+    void appendCard(int card);
+    void appendCards(const Hand& cards, bool hideSecondCard);
+    size_t size() const { return buffer.size(); }
+    void clear() { buffer.clear(); }
+    void flush();
 };
 
 // Player class
 // All player attributes and related functions
 class Player {
 private:
-    AVLTree hand[2];
-    int score[2];
-    bool activeHands[2];
+    Hand hand[2];
     bool doubledDown[2]; 
     int numberOfHands;
 
 public:
-    int* getHandArray(int handIndex, int &sz) const {
-        return hand[handIndex].toArray(sz);
+    const Hand& getHand(int handIndex=0) const {
+        return hand[handIndex];
     }
 
     Player();
     ~Player() = default;
     void addCard(int card, int handIndex=0);
-    int calculateScore(int handIndex=0);
-    bool hasBlackjack(int handIndex=0);
-    void showHand(bool hideFirstCard = false, int handIndex=0);
+    int calculateScore(int handIndex=0) const;
+    bool hasBlackjack(int handIndex=0) const;
+    void showHand(FrameBuffer& frame, bool hideFirstCard = false, int handIndex=0) const;
     int getScore(int handIndex=0) const;
     void clearHand();
     void sortHand(int handIndex=0);
-    void showSortedHand(int handIndex=0);
+    void showSortedHand(FrameBuffer& frame, int handIndex=0) const;
     std::string handToString(int handIndex=0) const;
     int getNumberOfHands() const;
     void setNumberOfHands(int n);
-    bool canSplit(int handIndex=0);
+    bool canSplit(int handIndex=0) const;
+    bool isSoft(int handIndex=0) const;
     void splitHand();
     void setDoubledDown(int handIndex, bool value);
     bool isDoubledDown(int handIndex) const;
 };
 
+// Online mean and variance
+/* Welford's update keeps the mean and the sum of squared deviations
+   numerically stable over billions of samples, and merge() combines two
+   runs exactly (Chan et al.), so workers can be summed in any grouping. */
+struct RunningStat {
+    long long count;
+    double mean;
+    double m2;          // Sum of squared deviations from the mean
+
+    RunningStat() : count(0), mean(0.0), m2(0.0) {}
+
+    void add(double x) {
+        count++;
+        double delta = x - mean;
+        mean += delta / count;
+        m2 += delta * (x - mean);
+    }
+
+    void merge(const RunningStat& other);
+    double variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+    double standardError() const { return count > 1 ? std::sqrt(variance() / count) : 0.0; }
+    // Half the width of the 95% confidence interval for the mean
+    double halfWidth95() const { return 1.959964 * standardError(); }
+};
+
 // Game statistics
+/* Besides the outcome counts, the net result of every hand (in dollars)
+   and of every automated round per initial bet are tracked as running
+   statistics. The mean return per initial bet is minus the house edge. */
 class GameStatistics {
 private:
-    int totalGames;
-    int playerWins;
-    int houseWins;
-    int ties;
+    long long totalGames;
+    long long playerWins;
+    long long houseWins;
+    long long ties;
+    RunningStat handNet;
+    RunningStat roundReturn;
 
 public:
     GameStatistics();
-    void recordResult(int result);
-    void displayStatistics() const;
+    void recordResult(int result, double net);
+    void recordRound(double net, double initialBet);
+    void merge(const GameStatistics& other);
+    void displayStatistics(std::ostream& out = std::cout) const;
+    long long getTotalGames() const { return totalGames; }
+    const RunningStat& getHandNet() const { return handNet; }
+    const RunningStat& getRoundReturn() const { return roundReturn; }
+};
+
+// Wins, losses and ties per final hand
+/* Open-addressed table keyed by Hand::getKey(), with linear probing. It
+   only allocates when it grows past half full, so recording a hand is
+   O(1) and allocation-free once the table has seen the common hands. */
+class HandPerformanceTable {
+public:
+    struct Entry {
+        std::uint64_t key;
+        long long wins;
+        long long losses;
+        long long ties;
+    };
+
+    HandPerformanceTable();
+    void record(std::uint64_t key, int wins, int losses, int ties);
+    void merge(const HandPerformanceTable& other);
+    const Entry* find(std::uint64_t key) const;
+    size_t size() const { return used; }
+    // Occupied slots hold a key other than EMPTY_KEY
+    const std::vector<Entry>& getSlots() const { return slots; }
+
+    static const std::uint64_t EMPTY_KEY = ~std::uint64_t(0);
+
+private:
+    std::vector<Entry> slots;
+    size_t used;
+
+    Entry& slotFor(std::uint64_t key);
+    Entry& insert(std::uint64_t key);
+    void grow();
+};
+
+// Round history
+/* One 8-byte record per settled hand, kept in fixed-size chunks that form
+   a ring. Chunks are allocated as the history grows and never beyond the
+   memory limit; after that the oldest hands are overwritten, so a session
+   can run for any number of hands in bounded memory. */
+class RoundHistory {
+public:
+    enum Flags {
+        HISTORY_DOUBLED = 1,
+        HISTORY_SPLIT = 2
+    };
+
+    struct Record {
+        signed char outcome;        // 1 win, -1 loss, 0 tie (ties go to the house)
+        unsigned char flags;
+        unsigned char playerTotal;
+        unsigned char houseTotal;
+        int net;                    // Won or lost on the hand, in cents
+    };
+
+    static const size_t CHUNK_RECORDS = 4096;
+    static const size_t DEFAULT_LIMIT = 4 << 20;    // Bytes (about half a million hands)
+
+    explicit RoundHistory(size_t limitBytes = DEFAULT_LIMIT);
+    ~RoundHistory();
+    RoundHistory(const RoundHistory&) = delete;
+    RoundHistory& operator=(const RoundHistory&) = delete;
+
+    // Changing the limit clears the history; 0 keeps no records at all
+    void setLimit(size_t limitBytes);
+
+    void add(const Record& record) {
+        if (capacity > 0) {
+            size_t slot = static_cast<size_t>(total % capacity);
+            Record*& chunk = chunks[slot / CHUNK_RECORDS];
+            if (!chunk) chunk = new Record[CHUNK_RECORDS];
+            chunk[slot % CHUNK_RECORDS] = record;
+        }
+        total++;
+    }
+
+    // Hands are numbered from 0 over the whole session
+    long long getTotal() const { return total; }
+    long long getFirstKept() const { return total - static_cast<long long>(kept()); }
+    const Record& at(long long hand) const {
+        size_t slot = static_cast<size_t>(hand % capacity);
+        return chunks[slot / CHUNK_RECORDS][slot % CHUNK_RECORDS];
+    }
+
+private:
+    std::vector<Record*> chunks;
+    size_t capacity;        // Records, a whole number of chunks
+    long long total;
+
+    size_t kept() const {
+        return (total < static_cast<long long>(capacity)) ? static_cast<size_t>(total) : capacity;
+    }
+    void release();
+};
+
+// Settlement
+/* All money is kept in integer cents. A batch holds one entry per hand in
+   packed arrays (totals, flags, wager) and settleBatch resolves all of them
+   against their house totals in one pass with no branches on the outcome.
+   A win pays even money and a natural what the rules say (3:2 here, odd
+   cents rounded down), ties go to the house and a natural against a house
+   natural is a tie. */
+enum SettleFlags : unsigned char {
+    SETTLE_NATURAL = 1,         // Unsplit two-card 21
+    SETTLE_HOUSE_NATURAL = 2
+};
+
+struct SettlementBatch {
+    std::vector<unsigned char> playerTotal;
+    std::vector<unsigned char> houseTotal;
+    std::vector<unsigned char> flags;
+    std::vector<long long> wager;       // Cents, doubles included
+    std::vector<long long> payout;      // Set by settleBatch: returned to the bankroll, 0 if lost
+    std::vector<signed char> outcome;   // Set by settleBatch: 1 win, 0 tie, -1 loss
+
+    size_t size() const { return wager.size(); }
+    void clear();
+    void add(int playerTotal, int houseTotal, unsigned char flags, long long wager);
 };
 
-// Decision Tree
+// One hand; returns the payout and sets outcome as settleBatch does
+template <class Rules = StandardRules>
+inline long long settleHand(int playerTotal, int houseTotal, unsigned flags, long long wager, int& outcome) {
+    bool natural = (flags & SETTLE_NATURAL) && !(flags & SETTLE_HOUSE_NATURAL);
+    bool alive = playerTotal <= 21;
+    bool win = alive & ((houseTotal > 21) | (playerTotal > houseTotal) | natural);
+    bool tie = alive & !win & (playerTotal == houseTotal);
+    outcome = static_cast<int>(win) - static_cast<int>(!win & !tie);
+    long long bonus = natural ? Rules::naturalWinnings(wager) - wager : 0;
+    return win ? 2 * wager + bonus : 0;
+}
+
+template <class Rules = StandardRules>
+void settleBatch(SettlementBatch& batch);
+
+// Player and house actions
 enum ActionType {
     ACTION_STAND,
     ACTION_HIT,
@@ -305,100 +781,312 @@ enum ActionType {
     ACTION_SPLIT
 };
 
-struct DecisionNode {
-    ActionType action;
-    DecisionNode* next;
-    DecisionNode(ActionType a) : action(a), next(nullptr) {}
+// Legal actions for a hand, in menu order, plus the basic-strategy pick
+struct DecisionSet {
+    ActionType actions[4];
+    int count;
+    ActionType recommended;
+};
+
+// Strategy grid cells: stand, hit, double (else hit), double (else stand), split
+enum StrategyCell : unsigned char { CELL_S, CELL_H, CELL_DH, CELL_DS, CELL_P };
+
+// Columns are the house upcard 2-10 then ace
+struct StrategyGrid {
+    static const int UPCARDS = 10;
+    StrategyCell hard[22][UPCARDS];     // By total (rows below 4 are never reached)
+    StrategyCell soft[22][UPCARDS];     // By total (12-21)
+    StrategyCell pairs[12][UPCARDS];    // By card value (2-11, 11 = aces); H plays the total
 };
 
-class DecisionTree {
+// Decision tables
+/* Basic strategy is stored as constexpr grids (hard totals, soft totals
+   and pairs against the house upcard) and copied into the grid in use, so
+   a decision is a table lookup with no allocation. A table file written
+   by the strategy generator can replace it at startup. */
+class DecisionTable {
 public:
-    static DecisionNode* buildPlayerDecisionTree(bool canSplit, bool canDouble) {
-        DecisionNode* head = nullptr;
-        DecisionNode* tail = nullptr;
-
-        // Hit
-        {
-            DecisionNode* node = new DecisionNode(ACTION_HIT);
-            if (!head) head = node; else tail->next = node;
-            tail = node;
-        }
-        // Stand
-        {
-            DecisionNode* node = new DecisionNode(ACTION_STAND);
-            tail->next = node;
-            tail = node;
-        }
-        if (canDouble) {
-            DecisionNode* node = new DecisionNode(ACTION_DOUBLE);
-            tail->next = node;
-            tail = node;
-        }
-        if (canSplit) {
-            DecisionNode* node = new DecisionNode(ACTION_SPLIT);
-            tail->next = node;
-            tail = node;
-        }
+    static DecisionSet playerDecisions(const Hand& hand, int houseUpcard, bool canSplit, bool canDouble);
+    static ActionType recommendedAction(const Hand& hand, int houseUpcard, bool canSplit, bool canDouble);
+
+    // Not thread-safe: change the grid before any game starts
+    static const StrategyGrid& grid();
+    static void setGrid(const StrategyGrid& grid);
+
+    /* Table files have one line per row, e.g. "hard 12: H H S S S H H H H H"
+       or "pair A: P P P P P P P P P P", and # comments. Rows that are left
+       out keep their current cells. Both return false on any error. */
+    static bool loadGrid(const std::string& path);
+    static bool saveGrid(const std::string& path, const StrategyGrid& grid, const std::string& comment);
+};
 
-        return head;
+// Total-dependent optimal strategy for the shoe and rules of this table
+/* Dynamic programming over every (total, soft) state against each house
+   upcard, with card odds from a full shoe less the upcard. The upcards
+   are solved on up to threads threads. */
+StrategyGrid generateStrategyGrid(int threads);
+
+// Player policy for automated play
+/* A strategy replaces the keyboard when the game runs headless: it sizes
+   each bet and picks one of the legal actions for the hand in play. */
+class Strategy {
+public:
+    virtual ~Strategy() = default;
+    virtual const char* name() const = 0;
+    // Amounts in cents
+    virtual long long chooseBet(long long balance) = 0;
+    virtual ActionType chooseAction(const Player& player, int handIndex, int houseUpcard,
+                                    bool canSplit, bool canDouble) = 0;
+
+    // Called before each bet and decision; holeCard is 0 while it is not in play
+    virtual void observeShoe(const ShoeCounts& deck, int holeCard) {
+        (void)deck;
+        (void)holeCard;
     }
 
-    static DecisionNode* buildHouseDecisionTree(int houseScore) {
-        DecisionNode* head = nullptr;
-        DecisionNode* tail = nullptr;
+    // The system the shoe should count for this strategy, if any
+    virtual const CountingSystem* countingSystem() const {
+        return nullptr;
+    }
+};
 
-        if (houseScore < 17) {
-            DecisionNode* node = new DecisionNode(ACTION_HIT);
-            head = node;
-            tail = node;
-        } else {
-            DecisionNode* node = new DecisionNode(ACTION_STAND);
-            if (!head) head = node; else tail->next = node;
-            tail = node;
-        }
-        return head;
+// Textbook basic strategy, limited to the actions this table allows
+class BasicStrategy : public Strategy {
+public:
+    const char* name() const { return "basic"; }
+    long long chooseBet(long long balance);
+    ActionType chooseAction(const Player& player, int handIndex, int houseUpcard,
+                            bool canSplit, bool canDouble);
+};
+
+// Plays like the house under the given rules (soft 17 included), never doubles or splits
+class DealerStrategy : public Strategy {
+private:
+    RuleSet rules;
+
+public:
+    explicit DealerStrategy(const RuleSet& rules) : rules(rules) {}
+    const char* name() const { return "dealer"; }
+    long long chooseBet(long long balance);
+    ActionType chooseAction(const Player& player, int handIndex, int houseUpcard,
+                            bool canSplit, bool canDouble);
+};
+
+// Basic strategy play with a bet ramp on the true count
+class CountingStrategy : public Strategy {
+private:
+    const CountingSystem& system;
+    int maxUnits;
+    double trueCount;
+
+public:
+    CountingStrategy(const CountingSystem& system, int maxUnits);
+    const char* name() const { return system.name; }
+    long long chooseBet(long long balance);
+    ActionType chooseAction(const Player& player, int handIndex, int houseUpcard,
+                            bool canSplit, bool canDouble);
+    void observeShoe(const ShoeCounts& deck, int holeCard);
+    const CountingSystem* countingSystem() const { return &system; }
+};
+
+// Returns nullptr for an unknown strategy name. Counting systems take an
+// optional maximum bet in units, e.g. "hilo:12" (default 8). rules are the
+// table's, for strategies that follow the house.
+Strategy* createStrategy(const std::string& name, const RuleSet& rules);
+
+// Binary game log (LogWriter.h)
+class LogWriter;
+class LogChannel;
+enum LogOutcome : unsigned char;
+
+// Multi-threaded headless run; every worker owns a shoe, RNG and accumulators
+// and, when a log is given, its own channel into it. A precision above 0
+// stops early once the house edge's 95% interval is narrower than that
+// many percentage points. The pipeline option adds a thread that shuffles
+// shoes ahead of the workers.
+void simulateParallel(long long rounds, const std::string& strategyName, int threads, std::uint64_t seed,
+                      LogWriter* log = nullptr, size_t historyLimit = RoundHistory::DEFAULT_LIMIT,
+                      double precision = 0.0, bool pipeline = false);
+
+// Where an interactive session stands: the question it is waiting on
+enum TableState {
+    TABLE_SEATS,
+    TABLE_BET,              // For the pending seat
+    TABLE_ACTION,           // For the pending seat's pending hand
+    TABLE_PLAY_AGAIN,
+    TABLE_OVER
+};
+
+// Where an interactive session's answers come from
+/* The game renders each prompt into its frame and flushes it before it
+   asks, and checks every answer as if it had been typed, so an invalid
+   one is simply asked for again. Each method returns false once the input
+   has ended, and the session stops there. */
+class SessionInput {
+public:
+    virtual ~SessionInput() = default;
+
+    // Start menu: 1 plays, 2 shows the rules and plays, 3 exits
+    virtual bool menuChoice(int& choice) {
+        choice = 1;
+        return true;
     }
 
-    static void destroyTree(DecisionNode* head) {
-        while (head) {
-            DecisionNode* temp = head;
-            head = head->next;
-            delete temp;
-        }
+    virtual bool seatCount(int& seats) = 0;
+    virtual bool bet(int seat, long long& wager) = 0;   // Cents
+    // Position in decisions.actions, from 1
+    virtual bool action(int seat, int handIndex, const DecisionSet& decisions, int& choice) = 0;
+    virtual bool playAgain() = 0;
+
+    // Called once each round is settled, with the balance it left
+    virtual void roundSettled(long long balance) {
+        (void)balance;
     }
 };
 
+// Answers given as words
+/* Each answer is one whitespace-separated word: numbers for the menu, the
+   seat count and action positions, bets in dollars, and anything but "n"
+   to play again. An action may also be named by its first letter (h, s,
+   d or p) or given as "*" for the recommended one. A word that does not
+   parse is passed on as an invalid answer, so it is asked for again. */
+class TokenInput : public SessionInput {
+public:
+    bool menuChoice(int& choice);
+    bool seatCount(int& seats);
+    bool bet(int seat, long long& wager);
+    bool action(int seat, int handIndex, const DecisionSet& decisions, int& choice);
+    bool playAgain();
+
+    // One word as the answer to question, as the game's answer() takes it
+    static long long parseAnswer(const std::string& token, TableState question, const DecisionSet* decisions);
+
+protected:
+    // The next answer; false once the input has ended
+    virtual bool nextToken(std::string& token) = 0;
+};
+
+// Answers typed at the console
+class ConsoleInput : public TokenInput {
+protected:
+    bool nextToken(std::string& token);
+};
+
 // Game class to manage game and information
-class BlackjackGame {
+/* The deck, the player's choices, the house's draw and the payouts all
+   follow Rules. BlackjackGame is this table; BasicBlackjackGame<RuntimeRules>
+   plays whatever rules were set at startup. */
+template <class Rules>
+class BasicBlackjackGame {
+public:
+    static const int MAX_SEATS = 7;
+
 private:
-    float balance;
-    float initialBalance;
-    int* gameHistory;
-    int historyCount;
-    CardDeck deck;
-    std::ofstream log;
-    std::queue<Player> players;
+    // Money is in cents
+    long long balance;
+    long long initialBalance;
+    RoundHistory history;
+    bool headless;          // No console output (simulation)
+    long long totalWagered;     // Sum of all bets, including doubles and splits
+    BasicCardDeck<Rules> deck;
+    LogChannel* logChannel;     // Binary log queue, or nullptr when not logging
+    Player seats[MAX_SEATS];        // Seats 0 to numSeats-1 are in play
+    long long seatWagers[MAX_SEATS][2];     // Per hand, so a double or split covers only its own hand
+    int numSeats;
     GameStatistics stats;
+    FrameBuffer frame;
+    SettlementBatch settlement;     // Reused every round
 
-    // Using std::hash<std::string> for hashing the player's final hand
-    // This is the name of the hashing function: std::hash<std::string>
-    std::hash<std::string> handHash;
-    // Map from hash value of hand to performance: [wins, losses, ties]
-    std::map<size_t, std::array<int,3>> handPerformance;
+    // Performance of each final hand, keyed by its rank counts
+    HandPerformanceTable handPerformance;
 
-    void logDetailedState();
+    // Interactive session state
+    TableState tableState;
+    int pendingSeat;
+    int pendingHand;
+    DecisionSet pendingDecisions;
+    Player tableHouse;      // The house's cards this round
+
+    long long settleResult(const Player& player, int handIndex, int houseTotal, long long wager,
+                           int outcome, long long payout);
+    void recordHistory(const Player& player, int handIndex, int houseTotal, int outcome, long long net);
+    void logHand(LogOutcome outcome, const Player& player, int handIndex, int houseTotal);
+
+    bool splitAllowed(const Player& player, int handIndex) const {
+        return Rules::canSplit() && player.getNumberOfHands() < 2 && player.canSplit(handIndex);
+    }
+
+    bool doubleAllowed(const Player& player, int handIndex) const {
+        const Hand& cards = player.getHand(handIndex);
+        return cards.getSize() == 2 && !player.isDoubledDown(handIndex) &&
+               Rules::canDouble(cards.getTotal(), cards.isSoft(), player.getNumberOfHands() == 2);
+    }
+
+    bool houseHits(const Player& house) const {
+        return Rules::houseHits(house.getScore(0), house.isSoft(0));
+    }
+
+    // Session steps; each renders the next question into the frame
+    void promptBet();
+    void placeBet(long long wager);
+    void dealRound();
+    void nextDecision(bool turnOver);
+    void promptAction();
+    void playAction(long long choice);
+    void finishRound();
+    void endSession();
 
 public:
-    BlackjackGame();
-    ~BlackjackGame();
+    static const long long MIN_BET = 500;   // Cents
+
+    BasicBlackjackGame(bool headless = false);
+    ~BasicBlackjackGame();
+    void setQuiet(bool quiet);
     void playGame();
-    void displayHistory() const;
-    void logResult(const std::string& result);
-    void placeBet(float& bet);
-    void handleResult(Player& player, Player& house, float& bet, int handIndex);
+    // The same game with its answers from input, e.g. a recording
+    void playSession(SessionInput& input);
+
+    /* The session one answer at a time: startSession asks for the seat
+       count, and each answer (seats, a bet in cents, an action position
+       from 1, non-zero to play again) runs the table up to its next
+       question. */
+    void startSession();
+    void answer(long long value);
+    // No more answers: the session ends as it does when console input ends
+    void endInput();
+    TableState getTableState() const { return tableState; }
+    int getPendingSeat() const { return pendingSeat; }
+    int getPendingHand() const { return pendingHand; }
+    const DecisionSet& getPendingDecisions() const { return pendingDecisions; }
+    // Frames go to out instead of the console (deck messages are dropped)
+    void setOutput(std::string* out);
+    void flushOutput() { frame.flush(); }
+    void playAutomatedRound(Strategy& strategy);
+    void simulate(long long rounds, Strategy& strategy);
+    void simulateShoe(const Xoshiro256& stream, long long rounds, Strategy& strategy);
+    void simulateShoe(const PreparedShoe* shoes, int count, long long rounds, Strategy& strategy);
+    void setSeed(std::uint64_t seed);
+    void mergeResults(const BasicBlackjackGame& other);
+    void reportSimulation(long long rounds, const char* strategyName, double seconds) const;
+    void displayHistory(std::ostream& out = std::cout) const;
+    void setHistoryLimit(size_t limitBytes);
+    void setLog(LogWriter& writer);
+    // Settles one hand and returns the player's net result on it, in cents
+    long long handleResult(Player& player, Player& house, long long wager, int handIndex);
+    // Settles every hand of count seats in one batch; returns the total net in cents
+    long long settleRound(Player* players, long long (*wagers)[2], int count, const Player& house);
     void initializePlayers(int numPlayers);
     void printRules() const;
     void displayBalanceReport() const;
+    const GameStatistics& getStatistics() const;
+    GameStatistics takeStatistics();
+    void addStatistics(const GameStatistics& other);
+    const HandPerformanceTable& getHandPerformance() const { return handPerformance; }
+    long long getBalance() const;
+    long long getInitialBalance() const { return initialBalance; }
+    long long getTotalWagered() const;
 };
 
+typedef BasicBlackjackGame<StandardRules> BlackjackGame;
+
 #endif // BLACKJACK_H
\ No newline at end of file
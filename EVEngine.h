@@ -0,0 +1,140 @@
+#ifndef EVENGINE_H
+#define EVENGINE_H
+
+#include "Blackjack.h"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Composition-dependent expected value engine
+/* Computes the expected value of standing, hitting, doubling and
+   splitting for a hand against the house upcard, given the cards that are
+   still unseen. Standing, hitting and doubling are exact at the default
+   depth. Two values are approximate:
+
+   - A split values each half on the same composition and doubles it, so
+     the second half does not see the cards the first half drew.
+   - Below FULLY_EXACT (setExactDepth) the house odds are frozen past that
+     many player cards. The ev strategy runs at depth 0, since a cold
+     fully exact query takes milliseconds; against fully exact, make bench
+     measures hit/double/split errors of at most about 0.003 of a bet from
+     a full shoe and 0.012 from the last 100 cards, with the same decision
+     in all but about 1% of positions.
+
+   The house's final-total distribution is memoized by a packed
+   shoe-composition key, so repeated queries within a shoe (every hit
+   after the first decision, other seats with the same cards gone) are
+   cache hits. Naturals are settled before any decision, so the values are
+   for hands that play on: ties go to the house and a win pays even money.
+   The house's draw and the doubles allowed after a split follow the rules
+   in RuntimeRules. */
+class EVEngine {
+public:
+    struct Result {
+        double stand;
+        double hit;
+        double doubleDown;      // Per initial bet (a doubled loss is -2)
+        double split;           // Both hands together, per initial bet
+        ActionType best;        // Best legal action
+    };
+
+    // Exact at every depth unless setExactDepth lowers it
+    static const int FULLY_EXACT = Hand::MAX_CARDS;
+
+    EVEngine();
+
+    // unseenCounts: cards per rank (index 1-13) not yet seen, hole card included
+    Result evaluate(const Hand& hand, int houseUpcard, const int unseenCounts[14],
+                    bool canSplit, bool canDouble);
+
+    /* Number of player cards drawn from the evaluated hand that still
+       recompute the house odds. Beyond that depth the subtree prices the
+       house with the odds at that depth (card-draw odds stay exact), which
+       trades a little accuracy for a large drop in cold-query time. */
+    void setExactDepth(int depth);
+    int getExactDepth() const { return exactDepth; }
+
+    void clearCache();
+    long long getCacheHits() const { return cacheHits; }
+    long long getCacheMisses() const { return cacheMisses; }
+
+private:
+    // House finishes on 17, 18, 19, 20, 21 or busts
+    struct HouseOdds {
+        double p[6];
+    };
+
+    // Scratch entry for one house-drawn multiset, valid for one generation
+    struct HouseScratch {
+        std::uint64_t drawn;
+        unsigned int generation;
+        double p[6];
+        HouseScratch() : drawn(0), generation(0) {}
+    };
+
+    // Composition, frozen ancestor composition (0 when exact) and hand state
+    struct StateKey {
+        std::uint64_t composition;
+        std::uint64_t anchor;
+        int state;
+        bool operator==(const StateKey& other) const {
+            return composition == other.composition && anchor == other.anchor && state == other.state;
+        }
+    };
+
+    struct StateKeyHash {
+        size_t operator()(const StateKey& key) const {
+            return static_cast<size_t>((key.composition ^ (key.anchor * 0xC2B2AE3D27D4EB4Full)) * 0x9E3779B97F4A7C15ull)
+                   ^ static_cast<size_t>(key.state);
+        }
+    };
+
+    static const size_t MAX_CACHE_ENTRIES = 1 << 20;
+    static const size_t HOUSE_SCRATCH_SIZE = 1 << 12;
+
+    // Unseen cards by value: index 0 = ace, 1-8 = two to nine, 9 = ten-valued
+    int counts[10];
+    int remaining;
+    int upcardValue;
+    int exactDepth;
+    int removalDepth;               // Player cards drawn below the evaluated hand
+    const HouseOdds* frozenOdds;
+    std::uint64_t frozenKey;
+    std::vector<HouseScratch> houseScratch;
+    unsigned int scratchGeneration;
+    size_t scratchUsed;
+
+    std::unordered_map<StateKey, HouseOdds, StateKeyHash> houseCache;
+    std::unordered_map<StateKey, double, StateKeyHash> hitCache;
+    long long cacheHits;
+    long long cacheMisses;
+
+    std::uint64_t compositionKey() const;
+    const HouseOdds* enterDraw();
+    const HouseOdds& houseOdds();
+    void houseFrom(int total, int softAces, std::uint64_t drawn, double out[6]);
+    double standEV(int total);
+    double hitEV(int total, int softAces);
+    double bestEV(int total, int softAces, bool allowDouble);
+    double doubleEV(int total, int softAces);
+    double splitEV(int pairValue);
+    static bool drawValue(int v, int& total, int& softAces);
+};
+
+// Picks the highest-EV action for the cards still unseen, at exact depth 0
+class EVStrategy : public Strategy {
+private:
+    EVEngine engine;
+    int unseen[14];
+
+public:
+    EVStrategy();
+    const char* name() const { return "ev"; }
+    long long chooseBet(long long balance);
+    ActionType chooseAction(const Player& player, int handIndex, int houseUpcard,
+                            bool canSplit, bool canDouble);
+    void observeShoe(const ShoeCounts& deck, int holeCard);
+    const EVEngine& getEngine() const { return engine; }
+};
+
+#endif // EVENGINE_H
@@ -0,0 +1,63 @@
+#ifndef HANDBATCH_H
+#define HANDBATCH_H
+
+#include "Blackjack.h"
+#include <cstdint>
+#include <vector>
+
+// Many independent hands scored in lockstep
+/* Each hand is kept as its hard total (aces as 1), an ace flag and a card
+   count, one array per field. The total then follows without a loop: ten
+   more than the hard total when the hand holds an ace and that still fits
+   under 21, which is exactly what Hand::addCard arrives at by demoting
+   aces one at a time. Every operation is one pass over the arrays, eight
+   hands per AVX2 instruction when the processor has it and one at a time
+   otherwise; both paths give the same results as Hand. It is a standalone
+   kernel: the simulator still plays each round's house hand with Hand. */
+class HandBatch {
+public:
+    // Bits set by classify
+    enum HandFlags {
+        HAND_SOFT = 1,          // An ace is counted as 11
+        HAND_BUST = 2,
+        HAND_BLACKJACK = 4      // Two cards totalling 21
+    };
+
+    explicit HandBatch(size_t hands = 0);
+
+    // Empty hands, n of them
+    void reset(size_t hands);
+    size_t size() const { return total.size(); }
+
+    // Add cards[i] (rank 1-13, 0 for no card) to hand i
+    void addCards(const unsigned char* cards);
+
+    /* The house's draw for every hand: a hand below 17, or at soft 17
+       with hitSoft17 (H17), takes its next card from
+       draws[step * size() + i], one column per step, and a hand that
+       stands never takes another. Returns the steps used, at most
+       maxSteps. */
+    int playHouse(const unsigned char* draws, int maxSteps, bool hitSoft17);
+
+    // HandFlags for every hand
+    void classify(unsigned char* flags) const;
+
+    int getTotal(size_t i) const { return total[i]; }
+    int getCardCount(size_t i) const { return count[i]; }
+    bool isSoft(size_t i) const { return total[i] != hard[i]; }
+    const std::int32_t* totals() const { return total.data(); }
+
+    // Use the AVX2 kernels when the processor supports them (the default)
+    static bool hasAvx2();
+    void setVectorized(bool enabled) { vectorized = enabled && hasAvx2(); }
+    bool isVectorized() const { return vectorized; }
+
+private:
+    std::vector<std::int32_t> hard;
+    std::vector<std::int32_t> ace;      // -1 once the hand holds an ace, else 0
+    std::vector<std::int32_t> count;
+    std::vector<std::int32_t> total;
+    bool vectorized;
+};
+
+#endif // HANDBATCH_H
@@ -0,0 +1,82 @@
+#ifndef INPUTSOURCE_H
+#define INPUTSOURCE_H
+
+#include "Blackjack.h"
+#include <functional>
+#include <string>
+
+// Scripted sessions
+/* A script holds one session per line: the answers to the start menu and
+   to every question the game asks after it, in order, as TokenInput reads
+   them, e.g.
+
+       1 2 10 25 h s * n     # play, two seats, bets, actions, then quit
+
+   The session ends where the line does, as if the input had ended there.
+   Blank lines and text after '#' are ignored. */
+class ScriptInput : public TokenInput {
+public:
+    explicit ScriptInput(const std::string& line) : line(line), pos(0), rounds(0) {}
+
+    void roundSettled(long long balance) {
+        (void)balance;
+        rounds++;
+    }
+
+    long long getRounds() const { return rounds; }
+
+    // False for a line with no answers on it
+    static bool hasAnswers(const std::string& line);
+
+protected:
+    bool nextToken(std::string& token);
+
+private:
+    std::string line;
+    size_t pos;
+    long long rounds;
+};
+
+// In-process sessions
+/* Every question goes to one function, which writes the answer and
+   returns false to end the input. Answers are numbers: the menu choice,
+   the seat count, a bet in cents, an action position from 1, and non-zero
+   to play again. */
+enum InputQuestion {
+    INPUT_MENU,
+    INPUT_SEATS,
+    INPUT_BET,
+    INPUT_ACTION,
+    INPUT_PLAY_AGAIN
+};
+
+struct InputRequest {
+    InputQuestion question;
+    int seat;                       // Bets and actions
+    int handIndex;                  // Actions
+    const DecisionSet* decisions;   // Actions, otherwise nullptr
+};
+
+typedef std::function<bool(const InputRequest& request, long long& answer)> InputCallback;
+
+class CallbackInput : public SessionInput {
+public:
+    // settled, when given, is told the balance after each round
+    explicit CallbackInput(InputCallback ask, std::function<void(long long)> settled = nullptr)
+        : ask(ask), settled(settled) {}
+
+    bool menuChoice(int& choice);
+    bool seatCount(int& seats);
+    bool bet(int seat, long long& wager);
+    bool action(int seat, int handIndex, const DecisionSet& decisions, int& choice);
+    bool playAgain();
+    void roundSettled(long long balance);
+
+private:
+    InputCallback ask;
+    std::function<void(long long)> settled;
+
+    bool askFor(InputQuestion question, int seat, int handIndex, const DecisionSet* decisions, long long& answer);
+};
+
+#endif // INPUTSOURCE_H
@@ -0,0 +1,67 @@
+#ifndef LOGANALYZER_H
+#define LOGANALYZER_H
+
+#include "Blackjack.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Game log analysis
+/* Reads a whole game log, the text format of game_log.txt or a binary log
+   from LogWriter, and totals it: outcomes, the balance over time and the
+   results of every distinct final hand. The file is memory-mapped and cut
+   into one chunk per thread; text chunks are cut at the start of a Result:
+   line so a result and the Hand Hash: line after it are always parsed
+   together, binary chunks at record boundaries. Chunks are parsed in
+   parallel and merged in file order. */
+
+enum AnalysisOutcome {
+    ANALYSIS_WIN,
+    ANALYSIS_LOSS,
+    ANALYSIS_TIE,
+    ANALYSIS_OTHER,         // Results that settle no hand, such as quitting
+    ANALYSIS_OUTCOMES
+};
+
+// Balances after a run of consecutive results
+struct BalanceSegment {
+    long long results;
+    long long last;         // Cents
+    long long low;
+    long long high;
+};
+
+/* Rows of the reported trajectory are made of whole segments, and each
+   chunk starts a new one, so the rows can end a few results apart with a
+   different number of threads. */
+struct LogAnalysis {
+    static const long long SEGMENT_RESULTS = 1 << 12;
+
+    int chunks;                 // Parts of the log parsed in parallel
+    long long sessions;         // "Initial balance:" lines
+    long long detailedStates;   // "Detailed game state:" blocks
+    long long outcomes[ANALYSIS_OUTCOMES];
+    long long balances;         // Results that carry a balance
+    long long firstBalance;
+    long long lastBalance;
+    long long lowBalance;
+    long long highBalance;
+    std::vector<BalanceSegment> trajectory;
+    HandPerformanceTable hands;     // Keyed by the hand hash in the log
+    std::unordered_map<std::uint64_t, std::string> handNames;  // The hand's cards, as logged
+
+    LogAnalysis();
+    void addBalance(long long cents);
+    // Append a later part of the same log
+    void merge(const LogAnalysis& later);
+};
+
+// Analyze a log held in memory on up to threads threads; false if it is not a game log
+bool analyzeLogData(const char* data, size_t size, int threads, LogAnalysis& analysis);
+
+/* Memory-map the log at path, analyze it and write the report to out.
+   Returns false if the file cannot be read or is not a game log. */
+bool analyzeLog(const std::string& path, int threads, std::ostream& out);
+
+#endif // LOGANALYZER_H
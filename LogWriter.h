@@ -0,0 +1,107 @@
+#ifndef LOGWRITER_H
+#define LOGWRITER_H
+
+#include "Blackjack.h"
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+// Binary game log
+/* Every settled hand becomes one fixed-size record holding the outcome,
+   the balance afterwards, the house total and the player's final cards.
+   Records are pushed onto a per-game lock-free queue and a background
+   thread writes them out in large batches, so the game thread never
+   formats text or waits on the disk. convertLog turns a log back into the
+   text format of game_log.txt. */
+
+// Outcome of a settled hand, as shown in the text log
+enum LogOutcome : unsigned char {
+    LOG_PLAYER_BUSTS,
+    LOG_HOUSE_BUSTS,
+    LOG_PLAYER_WINS,
+    LOG_TIE,
+    LOG_HOUSE_WINS
+};
+
+struct LogRecord {
+    LogOutcome outcome;
+    unsigned char houseTotal;
+    unsigned char cardCount;
+    unsigned char cards[Hand::MAX_CARDS];
+    long long balance;          // Cents, after the hand is settled
+};
+
+// On disk: a magic header, then records of RECORD_SIZE bytes
+const char LOG_MAGIC[8] = { 'B', 'J', 'L', 'O', 'G', '0', '2', '\n' };
+const int LOG_RECORD_SIZE = 22;     // Outcome, house total, card count, 11 bytes of cards, balance
+
+void encodeLogRecord(const LogRecord& record, unsigned char out[LOG_RECORD_SIZE]);
+bool decodeLogRecord(const unsigned char in[LOG_RECORD_SIZE], LogRecord& record);
+
+// Single-producer, single-consumer ring of records
+/* The game thread is the only producer and the writer thread the only
+   consumer, so head and tail each have one writer and no lock is needed.
+   A full ring makes the producer yield until the writer catches up. */
+class LogChannel {
+public:
+    static const size_t CAPACITY = 1 << 14;     // Power of two
+
+    LogChannel() : head(0), tail(0) {}
+
+    void push(const LogRecord& record) {
+        size_t h = head.load(std::memory_order_relaxed);
+        while (h - tail.load(std::memory_order_acquire) == CAPACITY) {
+            std::this_thread::yield();
+        }
+        ring[h & (CAPACITY - 1)] = record;
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // Consumer side: copy out up to max records, oldest first
+    size_t pop(LogRecord* out, size_t max);
+
+private:
+    LogRecord ring[CAPACITY];
+    alignas(64) std::atomic<size_t> head;       // Next slot to fill
+    alignas(64) std::atomic<size_t> tail;       // Next slot to drain
+};
+
+// Owns the file, the channels and the writer thread
+class LogWriter {
+public:
+    static const int MAX_CHANNELS = 256;
+
+    LogWriter();
+    ~LogWriter();
+
+    /* Appends to path (the header is written to a new file); false on error
+       or if path holds something other than a binary log */
+    bool open(const std::string& path);
+    // Drains every channel, stops the thread and closes the file
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    // A queue for one producer thread; valid until close()
+    LogChannel* openChannel();
+
+    long long getRecordsWritten() const { return recordsWritten.load(); }
+
+private:
+    static const size_t BATCH_RECORDS = 4096;
+
+    int fd;
+    std::thread worker;
+    std::atomic<bool> running;
+    std::atomic<LogChannel*> channels[MAX_CHANNELS];
+    std::atomic<int> channelCount;
+    std::atomic<long long> recordsWritten;
+
+    void run();
+    size_t drain(LogRecord* batch, unsigned char* bytes);
+    bool writeAll(const unsigned char* data, size_t size);
+};
+
+// Write the text form of a binary log to out; false if it is not a log
+bool convertLog(const std::string& path, std::ostream& out);
+
+#endif // LOGWRITER_H
@@ -0,0 +1,122 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <iostream>
+
+#if defined(BLACKJACK_PROFILE) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PROFILE_TSC 1
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Hot-path instrumentation
+/* Built with BLACKJACK_PROFILE (make profile), PROFILE_SCOPE(phase) times
+   the rest of the enclosing block and PROFILE_COUNT(counter) counts an
+   event; without it both expand to nothing and the game is unchanged.
+   Times are read from the time-stamp counter where there is one (steady
+   clock otherwise) and kept per thread: each thread adds to its own block
+   of counters and a log-scale histogram per phase, with no locks or
+   atomics after the first use. The blocks outlive their threads and are
+   summed by profileReport. Phases nest, so a phase's time includes the
+   draws and settlements inside it. */
+enum ProfilePhase {
+    PROFILE_DRAW,           // CardDeck::drawCard, reshuffles included
+    PROFILE_RESHUFFLE,
+    PROFILE_DECISION,       // Legal actions and the strategy's choice
+    PROFILE_HOUSE,          // The house's draw
+    PROFILE_SETTLE,         // handleResult and settleRound
+    PROFILE_LOG,            // Queueing hands for the log writer
+    PROFILE_RENDER,         // Frame formatting and output
+    PROFILE_PHASES
+};
+
+enum ProfileCounter {
+    PROFILE_ROUNDS,
+    PROFILE_HANDS,          // Hands settled, splits included
+    PROFILE_DOUBLES,
+    PROFILE_SPLITS,
+    PROFILE_COUNTERS
+};
+
+// Phase breakdown (calls, total, mean, p50 and p99 per call) summed over every thread
+void profileReport(std::ostream& out);
+
+#ifdef BLACKJACK_PROFILE
+
+namespace profiler {
+
+// Buckets of 8 linear steps per power of two of ticks
+const int SUB_BUCKETS = 8;
+const int BUCKETS = 64 * SUB_BUCKETS;
+
+struct PhaseCounters {
+    std::uint64_t calls;
+    std::uint64_t ticks;
+    std::uint64_t histogram[BUCKETS];
+};
+
+struct ThreadCounters {
+    PhaseCounters phases[PROFILE_PHASES];
+    std::uint64_t counters[PROFILE_COUNTERS];
+};
+
+// This thread's block, registered on first use
+ThreadCounters& registerThread();
+
+inline ThreadCounters& local() {
+    static thread_local ThreadCounters* counters = nullptr;
+    if (!counters) counters = &registerThread();
+    return *counters;
+}
+
+inline std::uint64_t now() {
+#ifdef PROFILE_TSC
+    return __rdtsc();
+#else
+    return static_cast<std::uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+}
+
+inline int bucketFor(std::uint64_t ticks) {
+    if (ticks < SUB_BUCKETS) return static_cast<int>(ticks);
+    int log = 63 - __builtin_clzll(ticks);
+    int step = static_cast<int>((ticks >> (log - 3)) & (SUB_BUCKETS - 1));
+    return (log - 2) * SUB_BUCKETS + step;
+}
+
+inline void record(ProfilePhase phase, std::uint64_t ticks) {
+    PhaseCounters& counters = local().phases[phase];
+    counters.calls++;
+    counters.ticks += ticks;
+    counters.histogram[bucketFor(ticks)]++;
+}
+
+class Scope {
+public:
+    explicit Scope(ProfilePhase phase) : phase(phase), start(now()) {}
+    ~Scope() { record(phase, now() - start); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    ProfilePhase phase;
+    std::uint64_t start;
+};
+
+}
+
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
+#define PROFILE_SCOPE(phase) profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(phase)
+#define PROFILE_COUNT(counter) (profiler::local().counters[counter]++)
+
+#else
+
+#define PROFILE_SCOPE(phase) ((void)0)
+#define PROFILE_COUNT(counter) ((void)0)
+
+#endif
+
+#endif // PROFILER_H
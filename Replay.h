@@ -0,0 +1,90 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "Blackjack.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Session recordings
+/* A session is recorded as its shoe seed and rules followed by every
+   answer the game was given, in the order it asked for them: seat count,
+   bets, action choices and play-again answers, invalid ones included.
+   After each round the balance it left is stored as a checkpoint. Played
+   back through the same game with the same seed, the answers deal and
+   settle exactly the same hands, so a changed checkpoint or a question
+   asked out of turn means the engine now plays differently.
+
+   A file holds any number of sessions back to back (the game appends):
+   an 8-byte magic, the seed and rules (16 bytes), then one byte per event
+   with a zigzag varint where it carries a number. A round is written out
+   whole once it is settled, so a crash loses at most the round in play. */
+const char REPLAY_MAGIC[8] = { 'B', 'J', 'R', 'P', 'L', '0', '1', '\n' };
+
+enum ReplayEvent : unsigned char {
+    REPLAY_SEATS = 1,
+    REPLAY_BET,
+    REPLAY_ACTION,
+    REPLAY_PLAY_AGAIN,
+    REPLAY_QUIT,
+    REPLAY_SETTLED          // Balance after the round
+};
+
+// Passes answers through from another input and appends them to a file
+class SessionRecorder : public SessionInput {
+public:
+    SessionRecorder(SessionInput& input, std::uint64_t seed, const RuleSet& rules);
+    ~SessionRecorder();
+
+    // Appends to path; without an open file answers are only passed through
+    bool open(const std::string& path);
+
+    // Passed through unrecorded: the menu is not part of the game
+    bool menuChoice(int& choice) { return input.menuChoice(choice); }
+    bool seatCount(int& seats);
+    bool bet(int seat, long long& wager);
+    bool action(int seat, int handIndex, const DecisionSet& decisions, int& choice);
+    bool playAgain();
+    void roundSettled(long long balance);
+
+private:
+    SessionInput& input;
+    std::ofstream file;
+    std::string pending;        // Events since the last write
+    std::uint64_t seed;
+    RuleSet rules;
+
+    void record(ReplayEvent event, long long value);
+    void write();
+};
+
+struct RecordedSession {
+    std::string source;     // File it was read from
+    int index;              // Position in that file, from 1
+    std::uint64_t seed;
+    RuleSet rules;
+    std::vector<unsigned char> events;
+};
+
+// Every session in a recording file; false if it cannot be read or is not one
+bool readRecording(const std::string& path, std::vector<RecordedSession>& sessions);
+
+struct ReplayResult {
+    long long rounds;
+    long long hands;
+    bool diverged;
+    std::string message;    // Where and how, when it diverged
+};
+
+/* Plays a session back headless. Sessions recorded under other rules
+   than the standard table run on RuntimeRules, which must be set to the
+   session's rules first. */
+ReplayResult replaySession(const RecordedSession& session);
+
+/* Replays every session in the files on up to threads threads, grouped by
+   rules, and reports each divergence and the totals on out. Returns the
+   number of diverged sessions, or -1 if a file could not be read. */
+int replayRecordings(const std::vector<std::string>& paths, int threads, std::ostream& out);
+
+#endif // REPLAY_H
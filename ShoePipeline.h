@@ -0,0 +1,80 @@
+#ifndef SHOEPIPELINE_H
+#define SHOEPIPELINE_H
+
+#include "Blackjack.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Fixed-size single-producer, single-consumer queue
+/* One thread pushes and one pops, so head and tail each have a single
+   writer and no lock is needed. Both sides return false instead of
+   waiting, and the caller decides how to wait. */
+template <typename T, size_t CAPACITY>
+class SpscQueue {
+public:
+    SpscQueue() : head(0), tail(0) {}
+
+    bool tryPush(const T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == CAPACITY) return false;
+        ring[h % CAPACITY] = value;
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == t) return false;
+        out = ring[t % CAPACITY];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T ring[CAPACITY];
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+// Shoe-shuffling stage for the parallel simulation
+/* A producer thread shuffles the opening shoes of each chunk into a
+   preallocated job and hands it to a worker; the worker plays the chunk
+   and returns the job to be refilled. Every worker has its own ready and
+   spare queue, so each queue has exactly one producer and one consumer.
+   Shoes are shuffled from the chunk's own stream, so a chunk deals the
+   same cards with or without the pipeline. */
+class ShoePipeline {
+public:
+    // Shoes prepared per chunk; a 48-round chunk rarely gets past its second
+    static const int SHOES_PER_JOB = 2;
+    static const int JOBS_PER_WORKER = 4;
+
+    struct Job {
+        long long chunk;
+        PreparedShoe shoes[SHOES_PER_JOB];
+    };
+
+    explicit ShoePipeline(int workers);
+    ShoePipeline(const ShoePipeline&) = delete;
+    ShoePipeline& operator=(const ShoePipeline&) = delete;
+
+    /* Producer: fill jobs for chunks [first, last), chunk i on the stream
+       as it stands after i - first jumps, then tell every worker the run is
+       over. stream is left jumped past the last chunk. Shoes are dealt
+       for Rules. */
+    template <class Rules>
+    void produce(long long first, long long last, Xoshiro256& stream);
+
+    // Worker side: the next job, or nullptr when the producer is done
+    Job* next(int worker);
+    void release(int worker, Job* job);
+
+private:
+    int workers;
+    std::vector<Job> jobs;
+    std::vector<SpscQueue<Job*, JOBS_PER_WORKER + 1>> ready;    // Room for the end marker
+    std::vector<SpscQueue<Job*, JOBS_PER_WORKER>> spare;        // Jobs waiting to be refilled
+};
+
+#endif // SHOEPIPELINE_H
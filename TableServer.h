@@ -0,0 +1,61 @@
+#ifndef TABLESERVER_H
+#define TABLESERVER_H
+
+#include "Blackjack.h"
+#include <cstdint>
+#include <string>
+
+// Multi-table server
+/* Every client that connects gets a table of its own: a game with its own
+   shoe (seeded seed + n for the n-th table), seats and statistics, run as
+   a session state machine. One thread serves every table from an epoll
+   loop over non-blocking sockets, TCP on the loopback or a Unix socket.
+   Each connection keeps its unparsed input and unsent output; a client
+   that stops reading is not read from until its output drains.
+
+   Clients send the same words a script does, any number per line, each
+   answering the question in turn. The server sends the rendered table
+   or, with compact output, one line per question:
+
+       seats
+       bet SEAT BALANCE
+       action SEAT HAND OFFERED RECOMMENDED     e.g. "action 1 1 shd h"
+       again BALANCE
+       over BALANCE                             and the table closes
+
+   Seats and hands count from 1, balances are in dollars and actions are
+   the letters h, s, d and p. Linux only (epoll). */
+struct ServerAddress {
+    bool unixSocket;
+    std::string path;       // Unix socket
+    std::string host;       // IPv4, the loopback unless given
+    int port;
+};
+
+// "unix:PATH", "PORT" or "HOST:PORT"
+bool parseServerAddress(const std::string& text, ServerAddress& address);
+
+struct ServerOptions {
+    ServerAddress address;
+    std::uint64_t seed;
+    bool compact;           // Question lines instead of the rendered table
+    size_t historyLimit;    // Per table
+};
+
+// Serves tables until interrupted, then reports; returns the exit status
+int runTableServer(const ServerOptions& options);
+
+/* Keeps tables open against a compact server for seconds, each playing
+   rounds of one seat, $10 bets and the recommended action and closing
+   after ROUNDS_PER_TABLE rounds, when a new one is opened in its place. */
+struct LoadOptions {
+    static const int ROUNDS_PER_TABLE = 20;
+
+    ServerAddress address;
+    int tables;
+    double seconds;
+};
+
+int runLoadGenerator(const LoadOptions& options);
+
+#endif // TABLESERVER_H
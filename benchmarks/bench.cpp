@@ -0,0 +1,381 @@
+/*
+ * Purpose: Microbenchmarks and round-throughput benchmark for the game engine
+ * Usage: bench [output.json]   (run through "make bench")
+ */
+
+#include "Blackjack.h"
+#include "EVEngine.h"
+#include "HandBatch.h"
+#include "InputSource.h"
+#include "LogAnalyzer.h"
+#include "LogWriter.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+// Allocation counter: every operator new in the process goes through here
+static std::atomic<long long> allocationCount(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// Fixed seeds so every build measures the same card sequences
+static const unsigned int BENCH_SEED = 20241208u;
+
+// Keeps results alive so the compiler cannot drop the measured work
+static volatile long long sink = 0;
+
+struct BenchResult {
+    string name;
+    long long iterations;
+    double nsPerOp;
+    double allocsPerOp;
+};
+
+static vector<BenchResult> results;
+
+// Time a body over a fixed number of iterations
+template <typename Body>
+static void runBench(const char* name, long long iterations, Body body) {
+    long long allocsBefore = allocationCount.load();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (long long i = 0; i < iterations; i++) {
+        body(i);
+    }
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+    long long allocs = allocationCount.load() - allocsBefore;
+
+    BenchResult r;
+    r.name = name;
+    r.iterations = iterations;
+    r.nsPerOp = elapsed.count() / iterations;
+    r.allocsPerOp = static_cast<double>(allocs) / iterations;
+    results.push_back(r);
+    printf("%-28s %12lld iters %10.2f ns/op %8.3f allocs/op\n", name, iterations, r.nsPerOp, r.allocsPerOp);
+}
+
+int main(int argc, char* argv[]) {
+    const char* outputPath = (argc > 1) ? argv[1] : "bench_results.json";
+
+    // Microbenchmarks
+    CardDeck deck(BENCH_SEED);
+    deck.setQuiet(true);
+    runBench("CardDeck::drawCard", 20000000, [&](long long) {
+        sink += deck.drawCard();
+    });
+
+    runBench("CardDeck::reshuffle", 200000, [&](long long) {
+        deck.reshuffle();
+        sink += deck.getCardsDealt();
+    });
+
+    Player player;
+    runBench("Player::addCard+score", 10000000, [&](long long i) {
+        player.clearHand();
+        player.addCard(1 + static_cast<int>(i % 13));
+        player.addCard(1 + static_cast<int>((i * 7) % 13));
+        player.addCard(1 + static_cast<int>((i * 11) % 13));
+        sink += player.calculateScore(0);
+    });
+
+    char cardLines[CARD_ROWS][CARD_WIDTH + 1];
+    runBench("getCardGraphic", 5000000, [&](long long i) {
+        getCardGraphic(1 + static_cast<int>(i % 13), cardLines);
+        sink += cardLines[1][1];
+    });
+
+    // One seat's frame: three cards and the total, buffer reused
+    FrameBuffer frame;
+    Hand threeCards;
+    threeCards.addCard(10);
+    threeCards.addCard(1);
+    threeCards.addCard(7);
+    runBench("FrameBuffer::appendCards", 5000000, [&](long long) {
+        frame.appendCards(threeCards, false);
+        frame << "Total: " << threeCards.getTotal() << '\n';
+        sink += static_cast<long long>(frame.size());
+        frame.clear();
+    });
+
+    BlackjackGame game(true);
+    Player hand;
+    Player house;
+    hand.addCard(10);
+    hand.addCard(9);
+    house.addCard(10);
+    house.addCard(7);
+    runBench("BlackjackGame::handleResult", 2000000, [&](long long) {
+        game.handleResult(hand, house, BlackjackGame::MIN_BET, 0);
+    });
+
+    // A million packed hands against mixed house totals, naturals included
+    SettlementBatch batch;
+    const int batchHands = 1 << 20;
+    for (int i = 0; i < batchHands; i++) {
+        batch.add(12 + (i * 7) % 11, 17 + (i * 5) % 6, (i % 21 == 0) ? SETTLE_NATURAL : 0, 500 * (1 + i % 4));
+    }
+    runBench("settleBatch (1M hands)", 50, [&](long long i) {
+        settleBatch(batch);
+        sink += batch.payout[static_cast<size_t>(i)];
+    });
+
+    // House hands in lockstep: two cards each, then the draw to 17 (checked in tests/regression.cpp)
+    const int houseHands = 1 << 16;
+    const int houseSteps = 12;
+    vector<unsigned char> houseCards(static_cast<size_t>(houseHands) * (2 + houseSteps));
+    Xoshiro256 cardRng(BENCH_SEED);
+    for (size_t i = 0; i < houseCards.size(); i++) {
+        houseCards[i] = static_cast<unsigned char>(1 + cardRng.bounded(13));
+    }
+    HandBatch vectorBatch(houseHands);
+    HandBatch scalarBatch(houseHands);
+    scalarBatch.setVectorized(false);
+    vector<unsigned char> vectorFlags(houseHands);
+    vector<unsigned char> scalarFlags(houseHands);
+    for (int pass = 0; pass < 2; pass++) {
+        HandBatch& batch = pass == 0 ? vectorBatch : scalarBatch;
+        runBench(pass == 0 ? "HandBatch house (64K hands)" : "HandBatch scalar (64K hands)", 200, [&](long long) {
+            batch.reset(houseHands);
+            batch.addCards(houseCards.data());
+            batch.addCards(houseCards.data() + houseHands);
+            sink += batch.playHouse(houseCards.data() + 2 * houseHands, houseSteps,
+                                    StandardRules::ruleSet().hitSoft17);
+            batch.classify(pass == 0 ? vectorFlags.data() : scalarFlags.data());
+        });
+    }
+
+    // Same settlement with every hand queued for the binary log writer
+    string logPath = string(outputPath) + ".log";
+    LogWriter log;
+    BlackjackGame logged(true);
+    if (log.open(logPath)) {
+        logged.setLog(log);
+    }
+    runBench("handleResult (binary log)", 2000000, [&](long long) {
+        logged.handleResult(hand, house, BlackjackGame::MIN_BET, 0);
+    });
+    log.close();
+
+    // The log just written analyzed whole, then the same hands as text
+    ifstream logFile(logPath.c_str(), ios::binary);
+    std::vector<char> logBytes((istreambuf_iterator<char>(logFile)), istreambuf_iterator<char>());
+    logFile.close();
+    runBench("analyzeLogData (binary, 2M)", 5, [&](long long) {
+        LogAnalysis analysis;
+        analyzeLogData(logBytes.data(), logBytes.size(), 1, analysis);
+        sink += analysis.hands.size();
+    });
+    {
+        ofstream part(logPath.c_str(), ios::binary | ios::trunc);
+        part.write(logBytes.data(), static_cast<std::streamsize>(
+            std::min(logBytes.size(), sizeof(LOG_MAGIC) + 200000 * static_cast<size_t>(LOG_RECORD_SIZE))));
+    }
+    ostringstream logText;
+    convertLog(logPath, logText);
+    string text = logText.str();
+    runBench("analyzeLogData (text, 200K)", 20, [&](long long) {
+        LogAnalysis analysis;
+        analyzeLogData(text.data(), text.size(), 1, analysis);
+        sink += analysis.hands.size();
+    });
+    remove(logPath.c_str());
+
+    // Hard 12 against each upcard from a full shoe, cache cleared every query
+    EVEngine engine;
+    CardDeck fullShoe(BENCH_SEED);
+    int unseen[14];
+    for (int rank = 1; rank <= 13; rank++) {
+        unseen[rank] = fullShoe.getRankCount(rank);
+    }
+    Hand twelve;
+    twelve.addCard(10);
+    twelve.addCard(2);
+    runBench("EVEngine::evaluate (cold)", 200, [&](long long i) {
+        engine.clearCache();
+        sink += engine.evaluate(twelve, 1 + static_cast<int>(i % 10), unseen, false, false).best;
+    });
+    runBench("EVEngine::evaluate (warm)", 200000, [&](long long i) {
+        sink += engine.evaluate(twelve, 1 + static_cast<int>(i % 10), unseen, false, false).best;
+    });
+    engine.setExactDepth(0);
+    runBench("EVEngine::evaluate depth 0", 2000, [&](long long i) {
+        engine.clearCache();
+        sink += engine.evaluate(twelve, 1 + static_cast<int>(i % 10), unseen, false, false).best;
+    });
+
+    /* What the ev strategy gives up: depth 0 against fully exact on the
+       same positions, two-card hands against every upcard, from a full shoe
+       and from its last cards before the cut. Regret is the exact EV lost
+       by taking the depth-0 choice. */
+    CardDeck deepShoe(BENCH_SEED);
+    deepShoe.setQuiet(true);
+    for (int i = 0; i < 260; i++) {     // The cut comes at 273 of 364
+        deepShoe.drawCard();
+    }
+    int deepUnseen[14];
+    for (int rank = 1; rank <= 13; rank++) {
+        deepUnseen[rank] = deepShoe.getRankCount(rank);
+    }
+    for (int shoe = 0; shoe < 2; shoe++) {
+        const int* shoeUnseen = shoe == 0 ? unseen : deepUnseen;
+        const int positions[][2] = { { 10, 2 }, { 10, 3 }, { 10, 6 }, { 9, 7 }, { 5, 6 }, { 4, 5 },
+                                     { 1, 6 }, { 1, 7 }, { 2, 2 }, { 8, 8 }, { 9, 9 } };
+        EVEngine exact;
+        EVEngine approximate;
+        approximate.setExactDepth(0);
+        double maxError = 0.0;
+        double totalError = 0.0;
+        double totalRegret = 0.0;
+        int values = 0;
+        int decisions = 0;
+        int disagreements = 0;
+        for (const int* cards : positions) {
+            for (int upcard = 1; upcard <= 10; upcard++) {
+                int left[14];
+                for (int rank = 1; rank <= 13; rank++) {
+                    left[rank] = shoeUnseen[rank];
+                }
+                left[cards[0]]--;
+                left[cards[1]]--;
+                left[upcard]--;
+                if (left[cards[0]] < 0 || left[cards[1]] < 0 || left[upcard] < 0) continue;
+                Hand hand;
+                hand.addCard(cards[0]);
+                hand.addCard(cards[1]);
+                bool pair = cards[0] == cards[1];
+                EVEngine::Result e = exact.evaluate(hand, upcard, left, pair, true);
+                EVEngine::Result a = approximate.evaluate(hand, upcard, left, pair, true);
+                double errors[3] = { fabs(e.hit - a.hit), fabs(e.doubleDown - a.doubleDown),
+                                     pair ? fabs(e.split - a.split) : 0.0 };
+                for (int k = 0; k < (pair ? 3 : 2); k++) {
+                    maxError = std::max(maxError, errors[k]);
+                    totalError += errors[k];
+                    values++;
+                }
+                const double byAction[4] = { e.stand, e.hit, e.doubleDown, e.split };     // By ActionType
+                totalRegret += byAction[e.best] - byAction[a.best];
+                disagreements += e.best != a.best;
+                decisions++;
+            }
+        }
+        printf("EV depth 0 against exact (%s): max error %.4f, mean %.5f per bet; %d of %d decisions differ, "
+               "mean regret %.6f\n", shoe == 0 ? "full shoe" : "last cards", maxError, totalError / values,
+               disagreements, decisions, totalRegret / decisions);
+    }
+
+    BasicStrategy strategy;
+    BlackjackGame scripted(true);
+    scripted.simulateShoe(Xoshiro256(BENCH_SEED), 0, strategy);
+    runBench("scripted round (basic)", 2000000, [&](long long) {
+        scripted.playAutomatedRound(strategy);
+    });
+
+    // The same rounds with every rule read at run time
+    BasicBlackjackGame<RuntimeRules> runtime(true);
+    runtime.simulateShoe(Xoshiro256(BENCH_SEED), 0, strategy);
+    runBench("scripted round (runtime rules)", 2000000, [&](long long) {
+        runtime.playAutomatedRound(strategy);
+    });
+
+    // Whole sessions through the interactive loop, answered from a script line
+    const string sessionScript = "1 10 * * * * y 10 * * * * y 10 * * * * n";
+    runBench("ScriptInput session", 20000, [&](long long i) {
+        ScriptInput input(sessionScript);
+        BlackjackGame session(true);
+        session.setHistoryLimit(0);
+        session.setSeed(BENCH_SEED + static_cast<std::uint64_t>(i));
+        session.playSession(input);
+        sink += session.getBalance();
+    });
+
+    // Sessions driven in process: one seat, minimum bets and the recommended action every time
+    const int sessionRounds = 20;
+    int roundsPlayed = 0;
+    long long sessionBalance = 0;
+    CallbackInput recommended([&](const InputRequest& request, long long& answer) {
+        if (request.question == INPUT_BET) {
+            answer = BlackjackGame::MIN_BET;
+        } else if (request.question == INPUT_ACTION) {
+            for (int c = 0; c < request.decisions->count; c++) {
+                if (request.decisions->actions[c] == request.decisions->recommended) answer = c + 1;
+            }
+        } else if (request.question == INPUT_PLAY_AGAIN) {
+            // Stop while a doubled split is still covered
+            answer = roundsPlayed < sessionRounds && sessionBalance >= 4 * BlackjackGame::MIN_BET;
+        } else {
+            answer = 1;
+        }
+        return true;
+    }, [&](long long balance) {
+        roundsPlayed++;
+        sessionBalance = balance;
+    });
+    runBench("CallbackInput session", 20000, [&](long long i) {
+        roundsPlayed = 0;
+        BlackjackGame session(true);
+        session.setHistoryLimit(0);
+        session.setSeed(BENCH_SEED + static_cast<std::uint64_t>(i));
+        session.playSession(recommended);
+        sink += session.getBalance();
+    });
+
+    // Round throughput over seeded shoe-sized chunks
+    const long long rounds = 5000000;
+    const long long roundsPerShoe = 48;
+    BlackjackGame throughput(true);
+    Xoshiro256 shoeStream(BENCH_SEED);
+    long long allocsBefore = allocationCount.load();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (long long done = 0; done < rounds; done += roundsPerShoe) {
+        throughput.simulateShoe(shoeStream, roundsPerShoe, strategy);
+        shoeStream.jump();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    long long allocs = allocationCount.load() - allocsBefore;
+    long long hands = throughput.getStatistics().getTotalGames();
+    double handsPerSec = hands / elapsed.count();
+    double nsPerHand = elapsed.count() * 1e9 / hands;
+    double allocsPerHand = static_cast<double>(allocs) / hands;
+    printf("throughput: %lld hands, %.0f hands/sec, %.2f ns/hand, %.3f allocs/hand\n",
+           hands, handsPerSec, nsPerHand, allocsPerHand);
+
+    // JSON report
+    FILE* out = fopen(outputPath, "w");
+    if (!out) {
+        fprintf(stderr, "Error: cannot write %s\n", outputPath);
+        return 1;
+    }
+    fprintf(out, "{\n  \"seed\": %u,\n  \"microbenchmarks\": [\n", BENCH_SEED);
+    for (size_t i = 0; i < results.size(); i++) {
+        fprintf(out, "    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": %.3f, \"allocs_per_op\": %.4f}%s\n",
+                results[i].name.c_str(), results[i].iterations, results[i].nsPerOp, results[i].allocsPerOp,
+                (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(out, "  ],\n  \"throughput\": {\"rounds\": %lld, \"hands\": %lld, \"hands_per_sec\": %.1f, "
+                 "\"ns_per_hand\": %.3f, \"allocs_per_hand\": %.4f}\n}\n",
+            rounds, hands, handsPerSec, nsPerHand, allocsPerHand);
+    fclose(out);
+    printf("Results written to %s\n", outputPath);
+    return 0;
+}
@@ -5,27 +5,244 @@
  */
 
 // System Libraries
-#include "blackjack.h"  // Header
+#include "Blackjack.h"  // Header
+#include "InputSource.h"
+#include "LogAnalyzer.h"
+#include "LogWriter.h"
+#include "Replay.h"
+#include "TableServer.h"
+#include <chrono>
 #include <iostream>
 #include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <thread>
 
 using namespace std;
 
+// Loaded at startup when it exists
+static const char* const DEFAULT_STRATEGY_TABLE = "strategy_table.txt";
+// Every interactive session is appended here for replay
+static const char* const DEFAULT_RECORDING = "game_sessions.bjr";
+
 // Function prototypes
 void displayWelcomeMessage();
-void displayGameMenu();
+bool displayGameMenu(SessionInput& input);
 void displayGoodbyeMessage();
+int runSimulation(long long rounds, const string& strategyName, int threads, std::uint64_t seed,
+                  const string& logPath, size_t historyLimit, double precision, bool pipeline);
+bool parseRules(const string& list, RuleSet& rules);
+template <class Rules>
+void playTable(SessionInput& input, std::uint64_t seed, bool quiet, size_t historyLimit, LogWriter& log,
+               const string& recordPath);
+template <class Rules>
+int runScript(const string& path, std::uint64_t seed, bool quiet, size_t historyLimit);
+
+int main(int argc, char* argv[]) {
+    // Command line options
+    long long simulateRounds = 0;
+    string strategyName = "basic";
+    int threads = static_cast<int>(thread::hardware_concurrency());
+    bool quiet = false;
+    bool pipeline = false;
+    bool profile = false;
+    string logPath;
+    size_t historyLimit = RoundHistory::DEFAULT_LIMIT;
+    double precision = 0.0;
+    std::uint64_t seed = randomSeed();     // The same seed replays the same cards
+    string strategyTable = DEFAULT_STRATEGY_TABLE;
+    bool strategyTableGiven = false;
+    string generatePath;
+    string analyzePath;
+    string scriptPath;
+    string serveAddress;
+    string loadAddress;
+    int loadTables = 100;
+    double loadSeconds = 10;
+    string recordPath = DEFAULT_RECORDING;
+    vector<string> replayPaths;
+    RuleSet rules = StandardRules::ruleSet();
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--simulate") == 0 && i + 1 < argc) {
+            simulateRounds = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            strategyName = argv[++i];
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            quiet = true;
+        } else if (strcmp(argv[i], "--pipeline") == 0) {
+            pipeline = true;
+        } else if (strcmp(argv[i], "--profile") == 0) {
+            // Per-phase timings at exit (builds made with 'make profile')
+            profile = true;
+        } else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc) {
+            logPath = argv[++i];
+        } else if (strcmp(argv[i], "--precision") == 0 && i + 1 < argc) {
+            precision = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--history-mb") == 0 && i + 1 < argc) {
+            historyLimit = static_cast<size_t>(atof(argv[++i]) * (1 << 20));
+        } else if (strcmp(argv[i], "--strategy-table") == 0 && i + 1 < argc) {
+            strategyTable = argv[++i];
+            strategyTableGiven = true;
+        } else if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            if (!parseRules(argv[++i], rules)) {
+                cerr << "Invalid rules: " << argv[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            // May be given more than once
+            replayPaths.push_back(argv[++i]);
+        } else if (strcmp(argv[i], "--generate-strategy") == 0 && i + 1 < argc) {
+            generatePath = argv[++i];
+        } else if (strcmp(argv[i], "--script") == 0 && i + 1 < argc) {
+            // Sessions played from a script ("-" reads standard input)
+            scriptPath = argv[++i];
+        } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+            // A table per connection; --quiet sends question lines instead of the table
+            serveAddress = argv[++i];
+        } else if (strcmp(argv[i], "--load-test") == 0 && i + 1 < argc) {
+            loadAddress = argv[++i];
+        } else if (strcmp(argv[i], "--tables") == 0 && i + 1 < argc) {
+            loadTables = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            loadSeconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--analyze-log") == 0 && i + 1 < argc) {
+            analyzePath = argv[++i];
+        } else if (strcmp(argv[i], "--convert-log") == 0 && i + 1 < argc) {
+            // Binary log to the text format of game_log.txt, on stdout
+            if (!convertLog(argv[i + 1], cout)) {
+                cerr << "Not a game log: " << argv[i + 1] << endl;
+                return 1;
+            }
+            return 0;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--simulate N] [--strategy basic|dealer|ev|hilo|ko|omega2|zen[:maxUnits]] [--threads T] [--seed S] [--pipeline] [--quiet] [--profile]"
+                 << " [--log FILE] [--convert-log FILE] [--analyze-log FILE] [--history-mb MB] [--precision PCT]"
+                 << " [--strategy-table FILE] [--generate-strategy FILE] [--record FILE] [--replay FILE]... [--script FILE|-]"
+                 << " [--serve unix:PATH|[HOST:]PORT] [--load-test unix:PATH|[HOST:]PORT] [--tables N] [--seconds S]"
+                 << " [--rules decks=N,penetration=PCT,h17|s17,blackjack=N:D,double-any,das|nodas,nosplit]" << endl;
+            return 1;
+        }
+    }
+    // Totals for a text or binary game log of any size, parsed on every thread
+    if (!analyzePath.empty()) {
+        if (!analyzeLog(analyzePath, threads, cout)) {
+            cerr << "Not a game log: " << analyzePath << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Anything but the standard table runs on the runtime-rules build
+    RuntimeRules::current = rules;
+
+    // Solve the strategy for this table's rules and write it out
+    if (!generatePath.empty()) {
+        StrategyGrid grid = generateStrategyGrid(threads);
+        if (!DecisionTable::saveGrid(generatePath, grid, "Total-dependent optimal strategy: " +
+                                     describeRules(rules) + ", ties go to the house")) {
+            cerr << "Error: cannot write " << generatePath << endl;
+            return 1;
+        }
+        cout << "Strategy table written to " << generatePath << endl;
+        return 0;
+    }
+
+    // A strategy table replaces basic strategy for the game and the simulators
+    ifstream tableFile(strategyTable.c_str());
+    if (tableFile || strategyTableGiven) {
+        tableFile.close();
+        if (!DecisionTable::loadGrid(strategyTable)) {
+            cerr << "Error: cannot load strategy table " << strategyTable << endl;
+            return 1;
+        }
+    }
+
+    // Recorded sessions played back headless; any divergence fails the run
+    if (!replayPaths.empty()) {
+        int diverged = replayRecordings(replayPaths, threads, cout);
+        if (profile) profileReport(cout);
+        return diverged == 0 ? 0 : 1;
+    }
 
-int main() {
-    srand(static_cast<unsigned int>(time(0))); // Seed for random number generation
+    // A precision target without a round budget runs until it is met
+    if (precision > 0 && simulateRounds == 0) {
+        simulateRounds = 1000000000LL;
+    }
+    if (simulateRounds > 0) {
+        int status = runSimulation(simulateRounds, strategyName, threads, seed, logPath, historyLimit, precision,
+                                   pipeline);
+        if (profile) profileReport(cout);
+        return status;
+    }
+
+    // Tables served to clients on a socket, and tables played against them
+    if (!serveAddress.empty()) {
+        ServerOptions options;
+        if (!parseServerAddress(serveAddress, options.address)) {
+            cerr << "Invalid address: " << serveAddress << endl;
+            return 1;
+        }
+        options.seed = seed;
+        options.compact = quiet;
+        options.historyLimit = historyLimit;
+        int status = runTableServer(options);
+        if (profile) profileReport(cout);
+        return status;
+    }
+    if (!loadAddress.empty()) {
+        LoadOptions options;
+        if (!parseServerAddress(loadAddress, options.address) || loadTables < 1 || loadSeconds <= 0) {
+            cerr << "Invalid load test: " << loadAddress << " with " << loadTables << " tables for "
+                 << loadSeconds << " s" << endl;
+            return 1;
+        }
+        options.tables = loadTables;
+        options.seconds = loadSeconds;
+        return runLoadGenerator(options);
+    }
+
+    // Every line of the script is a fresh game, from the menu on
+    if (!scriptPath.empty()) {
+        int status = (rules == StandardRules::ruleSet())
+                     ? runScript<StandardRules>(scriptPath, seed, quiet, historyLimit)
+                     : runScript<RuntimeRules>(scriptPath, seed, quiet, historyLimit);
+        if (profile) profileReport(cout);
+        return status;
+    }
+
+    // Quiet play reads input as usual but draws nothing; the menus and
+    // statistics that still write to cout are dropped with it
+    if (quiet) {
+        cout.setstate(ios::badbit);
+    }
 
     //Welcome message
     displayWelcomeMessage();
-    displayGameMenu();
+    ConsoleInput console;
+    if (!displayGameMenu(console)) {
+        return 0;
+    }
 
-    // Game
-    BlackjackGame game;
-    game.playGame();
+    // Game, logged in binary form
+    LogWriter log;
+    if (!log.open(logPath.empty() ? "game_log.bin" : logPath)) {
+        cerr << "Error: cannot open the game log." << endl;
+    }
+    if (rules == StandardRules::ruleSet()) {
+        playTable<StandardRules>(console, seed, quiet, historyLimit, log, recordPath);
+    } else {
+        playTable<RuntimeRules>(console, seed, quiet, historyLimit, log, recordPath);
+    }
+    if (profile) {
+        cout.clear();
+        profileReport(cout);
+    }
 
     // Final message
     displayGoodbyeMessage();
@@ -36,6 +253,114 @@ int main() {
 
 // Function definitions
 
+// Headless batch run, logged only when a log file is given
+int runSimulation(long long rounds, const string& strategyName, int threads, std::uint64_t seed,
+                  const string& logPath, size_t historyLimit, double precision, bool pipeline) {
+    // Only the name is checked here; each game builds its own for its rules
+    Strategy* strategy = createStrategy(strategyName, StandardRules::ruleSet());
+    if (!strategy) {
+        cerr << "Unknown strategy: " << strategyName << endl;
+        return 1;
+    }
+    delete strategy;
+    LogWriter log;
+    if (!logPath.empty() && !log.open(logPath)) {
+        cerr << "Error: cannot open log file " << logPath << endl;
+        return 1;
+    }
+    simulateParallel(rounds, strategyName, threads, seed, log.isOpen() ? &log : nullptr, historyLimit, precision,
+                     pipeline);
+    return 0;
+}
+
+// Interactive game on a table with the given rules, recorded for replay
+template <class Rules>
+void playTable(SessionInput& input, std::uint64_t seed, bool quiet, size_t historyLimit, LogWriter& log,
+               const string& recordPath) {
+    BasicBlackjackGame<Rules> game;
+    game.setSeed(seed);
+    game.setQuiet(quiet);
+    game.setHistoryLimit(historyLimit);
+    game.setLog(log);
+    SessionRecorder recorder(input, seed, Rules::ruleSet());
+    if (!recorder.open(recordPath)) {
+        cerr << "Error: cannot open the session recording." << endl;
+    }
+    game.playSession(recorder);
+}
+
+/* Scripted sessions through the menu and the game loop, session n on seed
+   + n. Quiet runs render nothing at all; the games are neither logged nor
+   recorded. */
+template <class Rules>
+int runScript(const string& path, std::uint64_t seed, bool quiet, size_t historyLimit) {
+    ifstream file;
+    if (path != "-") {
+        file.open(path.c_str());
+        if (!file) {
+            cerr << "Error: cannot open script " << path << endl;
+            return 1;
+        }
+    }
+    istream& script = (path == "-") ? cin : file;
+
+    long long sessions = 0, rounds = 0, hands = 0, net = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (quiet) cout.setstate(ios::badbit);
+    string line;
+    while (getline(script, line)) {
+        if (!ScriptInput::hasAnswers(line)) continue;
+        ScriptInput input(line);
+        BasicBlackjackGame<Rules> game(quiet);
+        game.setHistoryLimit(historyLimit);
+        game.setSeed(seed + static_cast<std::uint64_t>(sessions));
+        sessions++;
+        if (!quiet) displayWelcomeMessage();
+        if (displayGameMenu(input)) {
+            game.playSession(input);
+        }
+        rounds += input.getRounds();
+        hands += game.getStatistics().getTotalGames();
+        net += game.getBalance() - game.getInitialBalance();
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    cout.clear();
+
+    cout << "Seed: " << seed << endl;
+    cout << "Scripted " << sessions << " sessions, " << rounds << " rounds, " << hands << " hands in " << fixed
+         << setprecision(3) << elapsed.count() << " s (" << setprecision(0)
+         << (elapsed.count() > 0 ? sessions / elapsed.count() : 0) << " sessions/sec); net " << (net < 0 ? "-$" : "$")
+         << setprecision(2) << llabs(net) / 100.0 << endl;
+    return 0;
+}
+
+// Table rules from a comma-separated list; anything left out keeps its value
+bool parseRules(const string& list, RuleSet& rules) {
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        string item = list.substr(start, end - start);
+        start = end + 1;
+        char extra;
+        if (item == "h17" || item == "s17") {
+            rules.hitSoft17 = (item == "h17");
+        } else if (item == "das" || item == "nodas") {
+            rules.doubleAfterSplit = (item == "das");
+        } else if (item == "double-any") {
+            rules.doubleAnyTwo = true;
+        } else if (item == "nosplit") {
+            rules.split = false;
+        } else if (sscanf(item.c_str(), "decks=%d%c", &rules.decks, &extra) != 1 &&
+                   sscanf(item.c_str(), "penetration=%d%c", &rules.penetration, &extra) != 1 &&
+                   sscanf(item.c_str(), "blackjack=%d:%d%c", &rules.blackjackPays[0], &rules.blackjackPays[1],
+                          &extra) != 2) {
+            return false;
+        }
+    }
+    return rules.isValid();
+}
+
 // Welcome message
 void displayWelcomeMessage() {
     cout << "=========================================" << endl;
@@ -44,19 +369,22 @@ void displayWelcomeMessage() {
     cout << "Rules: The objective is to have a higher hand value than the dealer\n"
          << "without exceeding 21." << endl
          << "The dealer must hit if under 17. Ties go to the dealer.\n"
-         << "Up to three players are allowed.\n"
+         << "Up to seven players are allowed.\n"
          << "=========================================" << endl << endl;
 }
 
-// Game menu
-void displayGameMenu() {
+// Game menu; false to leave the game
+bool displayGameMenu(SessionInput& input) {
     cout << "Game Options:" << endl;
     cout << "1. Start a new game" << endl;
     cout << "2. View game rules" << endl;
     cout << "3. Exit the game" << endl;
     cout << "Please enter your choice (1-3): ";
+    cout.flush();
     int choice;
-    cin >> choice;
+    if (!input.menuChoice(choice)) {
+        return false;
+    }
 
     switch (choice) {
         case 1:
@@ -71,18 +399,22 @@ void displayGameMenu() {
                  << "- Aces count as 1 or 11, face cards as 10, and cards 2-10 are face value.\n"
                  << "- Place your bets before each round.\n"
                  << "- You can double down on your initial two-card hand.\n"
+                 << "- A blackjack (two-card 21, not after a split) pays " << RuntimeRules::current.blackjackPays[0]
+                 << ":" << RuntimeRules::current.blackjackPays[1] << ".\n"
                  << "- You can split if your initial two cards have the same rank, forming two separate hands.\n"
                  << "- The house draws until it has at least 17.\n"
+                 << "- Table: " << describeRules(RuntimeRules::current) << "\n"
                  << "=========================================" << endl << endl;
             break;
         case 3:
             cout << "Exiting the game. See you next time!" << endl;
-            exit(0);
+            return false;
         default:
             // Default settings if choice is invalid
             cout << "Invalid choice. Starting a new game by default." << endl << endl;
             break;
     }
+    return true;
 }
 
 // Goodbye message
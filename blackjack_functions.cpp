@@ -1,11 +1,28 @@
-#include "blackjack.h"
+#include "Blackjack.h"
+#include "LogWriter.h"
 #include <iostream>
 #include <algorithm>
+#include <sstream>
+#include <cstdio>
 #include <ctime>
 #include <cstring>
 
 using namespace std;
 
+// Counting systems (tags for A, 2-10, J, Q, K)
+const CountingSystem HI_LO = { "hilo", { 0, -1, 1, 1, 1, 1, 1, 0, 0, 0, -1, -1, -1, -1 } };
+const CountingSystem KNOCK_OUT = { "ko", { 0, -1, 1, 1, 1, 1, 1, 1, 0, 0, -1, -1, -1, -1 } };
+const CountingSystem OMEGA_II = { "omega2", { 0, 0, 1, 1, 2, 2, 2, 1, 0, -1, -2, -2, -2, -2 } };
+const CountingSystem ZEN_COUNT = { "zen", { 0, -1, 1, 1, 2, 2, 2, 1, 0, 0, -2, -2, -2, -2 } };
+
+const CountingSystem* findCountingSystem(const std::string& name) {
+    const CountingSystem* systems[] = { &HI_LO, &KNOCK_OUT, &OMEGA_II, &ZEN_COUNT };
+    for (int i = 0; i < 4; i++) {
+        if (name == systems[i]->name) return systems[i];
+    }
+    return nullptr;
+}
+
 // Functions
 
 // Display card
@@ -15,276 +32,181 @@ void displayCard(int card) {
 
 // Card graphics
 void displayCardGraphic(int card) {
-    char cardLines[6][7];
+    char cardLines[CARD_ROWS][CARD_WIDTH + 1];
     getCardGraphic(card, cardLines);
-    for (int line = 0; line < 6; ++line) {
+    for (int line = 0; line < CARD_ROWS; ++line) {
         cout << cardLines[line] << endl;
     }
 }
 
-// Custom card graphics
-void getCardGraphic(int card, char cardLines[6][7]) {
-    for (int i = 0; i < 6; ++i) {
-        for (int j = 0; j < 6; ++j) {
-            cardLines[i][j] = ' ';
+// Pre-rendered card faces: index 0 is the hidden card, 1-13 the ranks
+struct CardGlyphs {
+    char rows[14][CARD_ROWS][CARD_WIDTH + 1];
+
+    CardGlyphs() {
+        static const char* labels[14] = { "", "A", "2", "3", "4", "5", "6", "7", "8", "9", "10", "J", "Q", "K" };
+        for (int card = 0; card < 14; card++) {
+            for (int row = 0; row < CARD_ROWS; row++) {
+                const char* fill = "|     |";
+                if (row == 0 || row == CARD_ROWS - 1) {
+                    fill = "+-----+";
+                } else if (card == 0) {
+                    fill = "|#####|";
+                }
+                memcpy(rows[card][row], fill, CARD_WIDTH + 1);
+            }
+            // Rank in the top-left and bottom-right corners
+            size_t length = strlen(labels[card]);
+            memcpy(&rows[card][1][1], labels[card], length);
+            memcpy(&rows[card][CARD_ROWS - 2][CARD_WIDTH - 1 - length], labels[card], length);
         }
-        cardLines[i][6] = '\0';
-    }
-
-    strcpy(cardLines[0], "+-----+");
-    strcpy(cardLines[5], "+-----+");
-
-    char rankStr[3];
-    // Special cards
-    if (card == 1) {
-        strcpy(rankStr, "A");
-    } else if (card == 11) {
-        strcpy(rankStr, "J");
-    } else if (card == 12) {
-        strcpy(rankStr, "Q");
-    } else if (card == 13) {
-        strcpy(rankStr, "K");
-    } else {
-        sprintf(rankStr, "%d", card);
-    }
-
-    // Other cards
-    if (strlen(rankStr) == 1) {
-        cardLines[1][0] = '|';
-        cardLines[1][1] = rankStr[0];
-        cardLines[1][5] = '|';
-
-        cardLines[4][0] = '|';
-        cardLines[4][4] = rankStr[0];
-        cardLines[4][5] = '|';
-    } else if (strlen(rankStr) == 2) {
-        cardLines[1][0] = '|';
-        cardLines[1][1] = rankStr[0];
-        cardLines[1][2] = rankStr[1];
-        cardLines[1][5] = '|';
-
-        cardLines[4][0] = '|';
-        cardLines[4][3] = rankStr[0];
-        cardLines[4][4] = rankStr[1];
-        cardLines[4][5] = '|';
-    }
-
-    cardLines[2][0] = '|';
-    cardLines[2][5] = '|';
-    cardLines[3][0] = '|';
-    cardLines[3][5] = '|';
-
-    for (int i = 0; i < 6; ++i) {
-        cardLines[i][6] = '\0';
-    }
-}
-
-// Hidden house card(needs debugging)
-void getHiddenCardGraphic(char cardLines[6][7]) {
-    strcpy(cardLines[0], "+-----+");
-    strcpy(cardLines[1], "|#####|");
-    strcpy(cardLines[2], "|#####|");
-    strcpy(cardLines[3], "|#####|");
-    strcpy(cardLines[4], "|#####|");
-    strcpy(cardLines[5], "+-----+");
-}
-
-// Recursive score calculation
-int recursiveScore(int* arr, int size, int &aces) {
-    if (size == 0) return 0;
-    int card = arr[0];
-    int cardValue;
-    if (card > 10) {
-        cardValue = 10;
-    } else if (card == 1) {
-        cardValue = 11;
-        aces++;
-    } else {
-        cardValue = card;
     }
-    return cardValue + recursiveScore(arr+1, size-1, aces);
+};
+
+static const CardGlyphs glyphs;
+
+// Custom card graphics
+void getCardGraphic(int card, char cardLines[CARD_ROWS][CARD_WIDTH + 1]) {
+    memcpy(cardLines, glyphs.rows[card], sizeof(glyphs.rows[card]));
 }
 
-// Merge sort
-static void merge(int* arr, int left, int mid, int right) {
-    int n1 = mid - left + 1;
-    int n2 = right - mid;
+// Hidden house card
+void getHiddenCardGraphic(char cardLines[CARD_ROWS][CARD_WIDTH + 1]) {
+    memcpy(cardLines, glyphs.rows[0], sizeof(glyphs.rows[0]));
+}
 
-    int* L = new int[n1];
-    int* R = new int[n2];
+// FrameBuffer implementation
+FrameBuffer& FrameBuffer::operator<<(const char* text) {
+    if (!quiet) buffer += text;
+    return *this;
+}
 
-    for (int i = 0; i < n1; i++) {
-        L[i] = arr[left + i];
-    }
-    for (int j = 0; j < n2; j++) {
-        R[j] = arr[mid + 1 + j];
-    }
+FrameBuffer& FrameBuffer::operator<<(const std::string& text) {
+    if (!quiet) buffer += text;
+    return *this;
+}
 
-    int i = 0;
-    int j = 0;
-    int k = left;
+FrameBuffer& FrameBuffer::operator<<(char c) {
+    if (!quiet) buffer += c;
+    return *this;
+}
 
-    while (i < n1 && j < n2) {
-        if (L[i] <= R[j]) {
-            arr[k] = L[i];
-            i++;
-        } else {
-            arr[k] = R[j];
-            j++;
-        }
-        k++;
+FrameBuffer& FrameBuffer::operator<<(int value) {
+    if (!quiet) {
+        char text[16];
+        int length = snprintf(text, sizeof(text), "%d", value);
+        buffer.append(text, length);
     }
+    return *this;
+}
 
-    while (i < n1) {
-        arr[k] = L[i];
-        i++;
-        k++;
+FrameBuffer& FrameBuffer::operator<<(double value) {
+    if (!quiet) {
+        char text[32];
+        int length = snprintf(text, sizeof(text), "%.2f", value);
+        buffer.append(text, length);
     }
+    return *this;
+}
 
-    while (j < n2) {
-        arr[k] = R[j];
-        j++;
-        k++;
+// A single card, one glyph row per line
+void FrameBuffer::appendCard(int card) {
+    if (quiet) return;
+    PROFILE_SCOPE(PROFILE_RENDER);
+    for (int row = 0; row < CARD_ROWS; row++) {
+        buffer.append(glyphs.rows[card][row], CARD_WIDTH);
+        buffer += '\n';
     }
+}
 
-    delete[] L;
-    delete[] R;
+// Cards side by side; the house's hole card is the second card dealt
+void FrameBuffer::appendCards(const Hand& cards, bool hideSecondCard) {
+    if (quiet) return;
+    PROFILE_SCOPE(PROFILE_RENDER);
+    int numCards = cards.getSize();
+    for (int row = 0; row < CARD_ROWS; row++) {
+        for (int c = 0; c < numCards; c++) {
+            int glyph = (hideSecondCard && c == 1) ? 0 : cards.getCard(c);
+            buffer.append(glyphs.rows[glyph][row], CARD_WIDTH);
+            buffer += (c < numCards - 1) ? ' ' : '\n';
+        }
+    }
 }
 
-static void mergeSort(int* arr, int left, int right) {
-    if (left < right) {
-        int mid = (left + right) / 2;
-        mergeSort(arr, left, mid);
-        mergeSort(arr, mid+1, right);
-        merge(arr, left, mid, right);
+// Send the whole frame in one write
+void FrameBuffer::flush() {
+    if (buffer.empty()) return;
+    PROFILE_SCOPE(PROFILE_RENDER);
+    if (target) {
+        target->append(buffer);
+    } else {
+        cout.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        cout.flush();
     }
+    buffer.clear();
 }
 
 // Player implementation
 Player::Player() {
-    score[0] = 0;
-    score[1] = 0;
-    activeHands[0] = true;
-    activeHands[1] = false;
     doubledDown[0] = false;
     doubledDown[1] = false;
     numberOfHands = 1;
 }
 
 void Player::addCard(int card, int handIndex) {
-    hand[handIndex].insert(card);
-    score[handIndex] = calculateScore(handIndex);
+    hand[handIndex].addCard(card);
 }
 
-int Player::calculateScore(int handIndex) {
-    int sz = 0;
-    int* arr = hand[handIndex].toArray(sz);
-    int aces = 0;
-    int total = recursiveScore(arr, sz, aces);
-    while (total > 21 && aces > 0) {
-        total -= 10;
-        aces--;
-    }
-    delete[] arr;
-    return total;
+int Player::calculateScore(int handIndex) const {
+    return hand[handIndex].getTotal();
 }
 
-bool Player::hasBlackjack(int handIndex) {
-    return score[handIndex] == 21;
+// A natural: two cards totalling 21 that were dealt, not split
+bool Player::hasBlackjack(int handIndex) const {
+    return numberOfHands == 1 && hand[handIndex].getSize() == 2 && hand[handIndex].getTotal() == 21;
 }
 
-void Player::showHand(bool hideFirstCard, int handIndex) {
-    int sz = 0;
-    int* arr = hand[handIndex].toArray(sz);
-
-    char allCardLines[50][6][7];
-    int numCards = sz;
-    for (int i = 0; i < sz; i++) {
-        // FIX: When hideFirstCard is true (for house), show the first card and hide the second. (Still nor working)
-        if (hideFirstCard && i == 1) {
-            getHiddenCardGraphic(allCardLines[i]);
-        } else {
-            getCardGraphic(arr[i], allCardLines[i]);
-        }
-    }
-
-    for (int line = 0; line < 6; ++line) {
-        for (int c = 0; c < numCards; ++c) {
-            cout << allCardLines[c][line];
-            if (c < numCards - 1) cout << " ";
-        }
-        cout << endl;
-    }
+void Player::showHand(FrameBuffer& frame, bool hideFirstCard, int handIndex) const {
+    frame.appendCards(hand[handIndex], hideFirstCard);
 
     if (hideFirstCard) {
         // Total should be hidden if one card is hidden
-        cout << "Total: ??" << endl;
+        frame << "Total: ??\n";
     } else {
-        cout << "Total: " << getScore(handIndex) << endl;
+        frame << "Total: " << getScore(handIndex) << '\n';
     }
-
-    delete[] arr;
 }
 
 int Player::getScore(int handIndex) const {
-    return score[handIndex];
+    return hand[handIndex].getTotal();
 }
 
 void Player::clearHand() {
     hand[0].clear();
     hand[1].clear();
-    score[0] = 0;
-    score[1] = 0;
-    activeHands[0] = true;
-    activeHands[1] = false;
     doubledDown[0] = false;
     doubledDown[1] = false;
     numberOfHands = 1;
 }
 
 void Player::sortHand(int handIndex) {
-    int sz = 0;
-    int* arr = hand[handIndex].toArray(sz);
-    mergeSort(arr, 0, sz - 1);
-    hand[handIndex].clear();
-    for (int i = 0; i < sz; i++) {
-        hand[handIndex].insert(arr[i]);
-    }
-    delete[] arr;
+    hand[handIndex].sort();
 }
 
-// Display hand sorted with mergesort
-void Player::showSortedHand(int handIndex) {
-    int sz = 0;
-    int* arr = hand[handIndex].toArray(sz);
-
-    char allCardLines[50][6][7];
-    int numCards = sz;
-    for (int i = 0; i < sz; i++) {
-        getCardGraphic(arr[i], allCardLines[i]);
-    }
-
-    for (int line = 0; line < 6; ++line) {
-        for (int c = 0; c < numCards; ++c) {
-            cout << allCardLines[c][line];
-            if (c < numCards - 1) cout << " ";
-        }
-        cout << endl;
-    }
-
-    cout << "Total: " << getScore(handIndex) << endl;
-
-    delete[] arr;
+// Display hand in rank order
+void Player::showSortedHand(FrameBuffer& frame, int handIndex) const {
+    Hand sorted = hand[handIndex];
+    sorted.sort();
+    frame.appendCards(sorted, false);
+    frame << "Total: " << getScore(handIndex) << '\n';
 }
 
 std::string Player::handToString(int handIndex) const {
-    int sz = 0;
-    int* arr = getHandArray(handIndex, sz);
+    const Hand& cards = hand[handIndex];
     string result;
-    for (int i = 0; i < sz; i++) {
-        result += std::to_string(arr[i]) + " ";
+    for (int i = 0; i < cards.getSize(); i++) {
+        result += std::to_string(cards.getCard(i)) + " ";
     }
-    delete[] arr;
     return result;
 }
 
@@ -297,30 +219,24 @@ void Player::setNumberOfHands(int n) {
 }
 
 // Check for splitting conditions and give option to split
-bool Player::canSplit(int handIndex) {
-    int sz = 0;
-    int* arr = hand[handIndex].toArray(sz);
-    bool result = false;
-    if (sz == 2 && arr[0] == arr[1]) {
-        result = true;
-    }
-    delete[] arr;
-    return result;
+bool Player::canSplit(int handIndex) const {
+    return hand[handIndex].isPair();
+}
+
+// Soft hand: an ace is still being counted as 11
+bool Player::isSoft(int handIndex) const {
+    return hand[handIndex].isSoft();
 }
 
 void Player::splitHand() {
     if (numberOfHands < 2 && canSplit(0)) {
-        int sz = 0;
-        int* arr = hand[0].toArray(sz);
+        int first = hand[0].getCard(0);
+        int second = hand[0].getCard(1);
         hand[0].clear();
         hand[1].clear();
-        hand[0].insert(arr[0]);
-        hand[1].insert(arr[1]);
-        activeHands[1] = true;
+        hand[0].addCard(first);
+        hand[1].addCard(second);
         numberOfHands = 2;
-        score[0] = calculateScore(0);
-        score[1] = calculateScore(1);
-        delete[] arr;
     }
 }
 
@@ -334,9 +250,24 @@ bool Player::isDoubledDown(int handIndex) const {
 }
 
 // Statistics
+// RunningStat implementation
+void RunningStat::merge(const RunningStat& other) {
+    if (other.count == 0) return;
+    if (count == 0) {
+        *this = other;
+        return;
+    }
+    long long n = count + other.count;
+    double delta = other.mean - mean;
+    mean += delta * other.count / n;
+    m2 += other.m2 + delta * delta * (static_cast<double>(count) * other.count / n);
+    count = n;
+}
+
+// GameStatistics implementation
 GameStatistics::GameStatistics() : totalGames(0), playerWins(0), houseWins(0), ties(0) {}
 
-void GameStatistics::recordResult(int result) {
+void GameStatistics::recordResult(int result, double net) {
     totalGames++;
     if (result == 1) {
         playerWins++;
@@ -345,403 +276,829 @@ void GameStatistics::recordResult(int result) {
     } else {
         ties++;
     }
+    handNet.add(net);
+}
+
+// A whole round for one seat (split and doubled hands included)
+void GameStatistics::recordRound(double net, double initialBet) {
+    roundReturn.add(net / initialBet);
+}
+
+// Fold another worker's counts into this one
+void GameStatistics::merge(const GameStatistics& other) {
+    totalGames += other.totalGames;
+    playerWins += other.playerWins;
+    houseWins += other.houseWins;
+    ties += other.ties;
+    handNet.merge(other.handNet);
+    roundReturn.merge(other.roundReturn);
 }
 
 // Final game statistics
-void GameStatistics::displayStatistics() const {
-    cout << "Game Statistics:" << endl;
-    cout << "Total games played: " << totalGames << endl;
-    cout << "Player wins: " << playerWins << " (" << fixed << setprecision(2)
+void GameStatistics::displayStatistics(std::ostream& out) const {
+    out << "Game Statistics:" << endl;
+    out << "Total games played: " << totalGames << endl;
+    out << "Player wins: " << playerWins << " (" << fixed << setprecision(2)
          << (totalGames > 0 ? (static_cast<float>(playerWins) / totalGames * 100) : 0) << "%)" << endl;
-    cout << "House wins: " << houseWins << " (" << fixed << setprecision(2)
+    out << "House wins: " << houseWins << " (" << fixed << setprecision(2)
          << (totalGames > 0 ? (static_cast<float>(houseWins) / totalGames * 100) : 0) << "%)" << endl;
-    cout << "Ties: " << ties << " (" << fixed << setprecision(2)
+    out << "Ties: " << ties << " (" << fixed << setprecision(2)
          << (totalGames > 0 ? (static_cast<float>(ties) / totalGames * 100) : 0) << "%)" << endl;
+    if (handNet.count > 1) {
+        out << "Net per hand: $" << setprecision(4) << handNet.mean << " (SD " << std::sqrt(handNet.variance())
+             << ", SE " << handNet.standardError() << ", 95% CI " << handNet.mean - handNet.halfWidth95()
+             << " to " << handNet.mean + handNet.halfWidth95() << ")" << endl;
+    }
+    if (roundReturn.count > 1) {
+        double edge = -roundReturn.mean * 100;
+        double half = roundReturn.halfWidth95() * 100;
+        out << "House edge per initial bet: " << setprecision(3) << edge << "% (SE "
+             << roundReturn.standardError() * 100 << "%, 95% CI " << edge - half << "% to " << edge + half
+             << "%, " << roundReturn.count << " rounds)" << endl;
+    }
+}
+
+// RoundHistory implementation
+RoundHistory::RoundHistory(size_t limitBytes) : capacity(0), total(0) {
+    setLimit(limitBytes);
+}
+
+RoundHistory::~RoundHistory() {
+    release();
+}
+
+void RoundHistory::release() {
+    for (size_t i = 0; i < chunks.size(); i++) {
+        delete[] chunks[i];
+    }
+    chunks.clear();
+}
+
+// Whole chunks only, but at least one unless the limit is 0
+void RoundHistory::setLimit(size_t limitBytes) {
+    release();
+    size_t numChunks = limitBytes / (CHUNK_RECORDS * sizeof(Record));
+    if (numChunks == 0 && limitBytes > 0) numChunks = 1;
+    chunks.assign(numChunks, nullptr);
+    capacity = numChunks * CHUNK_RECORDS;
+    total = 0;
+}
+
+// HandPerformanceTable implementation
+HandPerformanceTable::HandPerformanceTable() : used(0) {
+    Entry empty = { EMPTY_KEY, 0, 0, 0 };
+    slots.assign(1024, empty);
+}
+
+// Linear probe from the key's hash to its slot or the first empty one
+HandPerformanceTable::Entry& HandPerformanceTable::slotFor(std::uint64_t key) {
+    size_t mask = slots.size() - 1;
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while (slots[slot].key != key && slots[slot].key != EMPTY_KEY) {
+        slot = (slot + 1) & mask;
+    }
+    return slots[slot];
+}
+
+void HandPerformanceTable::grow() {
+    std::vector<Entry> old;
+    old.swap(slots);
+    Entry empty = { EMPTY_KEY, 0, 0, 0 };
+    slots.assign(old.size() * 2, empty);
+    for (size_t i = 0; i < old.size(); i++) {
+        if (old[i].key != EMPTY_KEY) {
+            slotFor(old[i].key) = old[i];
+        }
+    }
+}
+
+// The entry for a key, claiming an empty slot (and growing) if needed
+HandPerformanceTable::Entry& HandPerformanceTable::insert(std::uint64_t key) {
+    Entry* entry = &slotFor(key);
+    if (entry->key == EMPTY_KEY) {
+        if ((used + 1) * 2 > slots.size()) {
+            grow();
+            entry = &slotFor(key);
+        }
+        entry->key = key;
+        used++;
+    }
+    return *entry;
+}
+
+void HandPerformanceTable::record(std::uint64_t key, int wins, int losses, int ties) {
+    Entry& entry = insert(key);
+    entry.wins += wins;
+    entry.losses += losses;
+    entry.ties += ties;
+}
+
+void HandPerformanceTable::merge(const HandPerformanceTable& other) {
+    for (size_t i = 0; i < other.slots.size(); i++) {
+        const Entry& theirs = other.slots[i];
+        if (theirs.key != EMPTY_KEY) {
+            Entry& mine = insert(theirs.key);
+            mine.wins += theirs.wins;
+            mine.losses += theirs.losses;
+            mine.ties += theirs.ties;
+        }
+    }
+}
+
+// nullptr when the hand has not been recorded
+const HandPerformanceTable::Entry* HandPerformanceTable::find(std::uint64_t key) const {
+    size_t mask = slots.size() - 1;
+    size_t slot = static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+    while (slots[slot].key != EMPTY_KEY) {
+        if (slots[slot].key == key) return &slots[slot];
+        slot = (slot + 1) & mask;
+    }
+    return nullptr;
+}
+
+// Two draws from the system's entropy source, mixed with the clock
+std::uint64_t randomSeed() {
+    std::random_device device;
+    std::uint64_t seed = (static_cast<std::uint64_t>(device()) << 32) | device();
+    return seed ^ static_cast<std::uint64_t>(time(0));
+}
+
+// Rules
+RuleSet RuntimeRules::current = StandardRules::ruleSet();
+
+std::string describeRules(const RuleSet& rules) {
+    std::string text = to_string(rules.decks) + (rules.decks == 1 ? " deck, " : " decks, ") +
+                       to_string(rules.penetration) + "% penetration, " + (rules.hitSoft17 ? "H17" : "S17") +
+                       ", blackjack " + to_string(rules.blackjackPays[0]) + ":" + to_string(rules.blackjackPays[1]) +
+                       (rules.doubleAnyTwo ? ", double any two" : ", double 9-11/soft 16-18");
+    if (!rules.split) return text + ", no splits";
+    return text + (rules.doubleAfterSplit ? ", DAS" : ", no DAS");
+}
+
+// TokenInput implementation
+static bool parseInt(const std::string& token, int& value) {
+    char* end;
+    long parsed = strtol(token.c_str(), &end, 10);
+    if (end == token.c_str() || *end != '\0') return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+bool TokenInput::menuChoice(int& choice) {
+    std::string token;
+    if (!nextToken(token)) return false;
+    if (!parseInt(token, choice)) choice = 0;
+    return true;
+}
+
+bool TokenInput::seatCount(int& seats) {
+    std::string token;
+    if (!nextToken(token)) return false;
+    seats = static_cast<int>(parseAnswer(token, TABLE_SEATS, nullptr));
+    return true;
+}
+
+bool TokenInput::bet(int seat, long long& wager) {
+    (void)seat;
+    std::string token;
+    if (!nextToken(token)) return false;
+    wager = parseAnswer(token, TABLE_BET, nullptr);
+    return true;
+}
+
+bool TokenInput::action(int seat, int handIndex, const DecisionSet& decisions, int& choice) {
+    (void)seat;
+    (void)handIndex;
+    std::string token;
+    if (!nextToken(token)) return false;
+    choice = static_cast<int>(parseAnswer(token, TABLE_ACTION, &decisions));
+    return true;
+}
+
+bool TokenInput::playAgain() {
+    std::string token;
+    if (!nextToken(token)) return false;
+    return parseAnswer(token, TABLE_PLAY_AGAIN, nullptr) != 0;
+}
+
+// Invalid words become answers the game turns down: 0 seats, a bet of -1, action 0
+long long TokenInput::parseAnswer(const std::string& token, TableState question, const DecisionSet* decisions) {
+    int number;
+    if (question == TABLE_SEATS) {
+        return parseInt(token, number) ? number : 0;
+    }
+    if (question == TABLE_BET) {
+        char* end;
+        double amount = strtod(token.c_str(), &end);
+        bool valid = end != token.c_str() && *end == '\0' && amount >= 0 && amount < 1e15;
+        return valid ? llround(amount * 100) : -1;
+    }
+    if (question == TABLE_PLAY_AGAIN) {
+        // Anything but "n" plays another round
+        return token != "n" && token != "N";
+    }
+    if (question != TABLE_ACTION || !decisions) return 0;
+    if (parseInt(token, number)) return number;
+
+    int wanted = -1;    // An ActionType
+    if (token == "*") {
+        wanted = decisions->recommended;
+    } else if (token.size() == 1) {
+        switch (tolower(static_cast<unsigned char>(token[0]))) {
+            case 'h':
+                wanted = ACTION_HIT;
+                break;
+            case 's':
+                wanted = ACTION_STAND;
+                break;
+            case 'd':
+                wanted = ACTION_DOUBLE;
+                break;
+            case 'p':
+                wanted = ACTION_SPLIT;
+                break;
+        }
+    }
+    for (int c = 0; c < decisions->count; c++) {
+        if (decisions->actions[c] == wanted) return c + 1;
+    }
+    return 0;
+}
+
+// ConsoleInput implementation
+bool ConsoleInput::nextToken(std::string& token) {
+    return static_cast<bool>(cin >> token);
 }
 
 // BlackjackGame class
-BlackjackGame::BlackjackGame() : balance(100.0), initialBalance(100.0), historyCount(0) {
-    gameHistory = new int[100];
-    log.open("game_log.txt", ios::app);
+template <class Rules>
+BasicBlackjackGame<Rules>::BasicBlackjackGame(bool isHeadless) : balance(10000), initialBalance(10000),
+                                                                 headless(isHeadless), totalWagered(0),
+                                                                 logChannel(nullptr), numSeats(0),
+                                                                 tableState(TABLE_OVER), pendingSeat(0),
+                                                                 pendingHand(0) {
+    pendingDecisions.count = 0;
+    deck.setQuiet(headless);
+    frame.setQuiet(headless);
+}
+
+template <class Rules>
+BasicBlackjackGame<Rules>::~BasicBlackjackGame() {
+}
+
+// Start a new shoe on the stream for seed
+template <class Rules>
+void BasicBlackjackGame<Rules>::setSeed(std::uint64_t seed) {
+    deck.reseed(seed);
+}
+
+// Skip all table rendering; input is still read as usual
+template <class Rules>
+void BasicBlackjackGame<Rules>::setQuiet(bool quiet) {
+    frame.setQuiet(quiet);
+    deck.setQuiet(quiet);
 }
 
-BlackjackGame::~BlackjackGame() {
-    delete[] gameHistory;
-    log.close();
+template <class Rules>
+void BasicBlackjackGame<Rules>::setOutput(std::string* out) {
+    frame.setTarget(out);
+    deck.setQuiet(true);
 }
 
-void BlackjackGame::initializePlayers(int numPlayers) {
-    for (int i = 0; i < numPlayers; ++i) {
-        Player newPlayer;
-        players.push(newPlayer);
+// Seats are reused in place from round to round
+template <class Rules>
+void BasicBlackjackGame<Rules>::initializePlayers(int numPlayers) {
+    numSeats = numPlayers;
+    for (int i = 0; i < numSeats; ++i) {
+        seats[i].clearHand();
+        seatWagers[i][0] = 0;
+        seatWagers[i][1] = 0;
     }
 }
 
 // Rules of the game
-void BlackjackGame::printRules() const {
+template <class Rules>
+void BasicBlackjackGame<Rules>::printRules() const {
+    RuleSet rules = Rules::ruleSet();
     cout << "Game Rules:" << endl;
     cout << "- Try to beat the house by getting as close to 21 as possible without going over." << endl;
     cout << "- Aces count as 1 or 11, face cards as 10, and cards 2-10 are face value." << endl;
-    cout << "- You can double down on your initial two-card hand (double bet, one card only)." << endl;
-    cout << "- You can split if your first two cards have the same rank, forming two hands." << endl;
-    cout << "- The house draws until it has at least 17." << endl;
+    cout << "- You can double down on your initial two-card hand (double bet, one card only)";
+    cout << (rules.doubleAnyTwo ? "." : " on hard 9-11 or soft 16-18.") << endl;
+    cout << "- A blackjack (two-card 21, not after a split) pays " << rules.blackjackPays[0] << ":"
+         << rules.blackjackPays[1] << "; other wins pay 1:1." << endl;
+    if (rules.split) {
+        cout << "- You can split if your first two cards have the same rank, forming two hands";
+        cout << (rules.doubleAfterSplit ? "." : " (no doubling after a split).") << endl;
+    }
+    cout << "- The house draws until it has at least 17" << (rules.hitSoft17 ? " and hits soft 17." : ".") << endl;
+    cout << "- Table: " << describeRules(rules) << endl;
 }
 
 // Balance report
-void BlackjackGame::displayBalanceReport() const {
-    cout << "Current balance report: $" << balance << endl;
-    cout << "Initial balance: $" << initialBalance << endl;
-    cout << "Net earnings: $" << balance - initialBalance << endl;
-}
-
-// Details of the game
-void BlackjackGame::logDetailedState() {
-    if (log.is_open()) {
-        log << "Detailed game state: " << endl;
-        queue<Player> tempPlayers = players;
-        int pIndex = 1;
-        while (!tempPlayers.empty()) {
-            Player player = tempPlayers.front();
-            for (int h = 0; h < player.getNumberOfHands(); h++) {
-                log << "Player " << pIndex << " hand " << h+1 << ": " << player.handToString(h)
-                    << " Score: " << player.getScore(h) << endl;
+template <class Rules>
+void BasicBlackjackGame<Rules>::displayBalanceReport() const {
+    cout << fixed << setprecision(2);
+    cout << "Current balance report: $" << balance / 100.0 << endl;
+    cout << "Initial balance: $" << initialBalance / 100.0 << endl;
+    cout << "Net earnings: $" << (balance - initialBalance) / 100.0 << endl;
+}
+
+// Hand the accumulated statistics to the caller and start over
+template <class Rules>
+GameStatistics BasicBlackjackGame<Rules>::takeStatistics() {
+    GameStatistics taken = stats;
+    stats = GameStatistics();
+    return taken;
+}
+
+template <class Rules>
+void BasicBlackjackGame<Rules>::addStatistics(const GameStatistics& other) {
+    stats.merge(other);
+}
+
+template <class Rules>
+const GameStatistics& BasicBlackjackGame<Rules>::getStatistics() const {
+    return stats;
+}
+
+template <class Rules>
+long long BasicBlackjackGame<Rules>::getBalance() const {
+    return balance;
+}
+
+template <class Rules>
+long long BasicBlackjackGame<Rules>::getTotalWagered() const {
+    return totalWagered;
+}
+
+// Interactive sessions
+/* A session is a state machine: each answer moves the table on to its
+   next question, rendering into the frame as it goes. playSession asks
+   an input in a loop; the table server feeds answers as they arrive. */
+template <class Rules>
+void BasicBlackjackGame<Rules>::startSession() {
+    frame << "Enter the number of players (1-" << MAX_SEATS << "): ";
+    tableState = TABLE_SEATS;
+}
+
+template <class Rules>
+void BasicBlackjackGame<Rules>::answer(long long value) {
+    switch (tableState) {
+        case TABLE_SEATS:
+            if (value < 1 || value > MAX_SEATS) {
+                frame << "Invalid number of players. Starting with 1 player.\n";
+                value = 1;
             }
-            pIndex++;
-            tempPlayers.pop();
-        }
+            initializePlayers(static_cast<int>(value));
+            pendingSeat = 0;
+            promptBet();
+            break;
+        case TABLE_BET:
+            placeBet(value);
+            break;
+        case TABLE_ACTION:
+            playAction(value);
+            break;
+        case TABLE_PLAY_AGAIN:
+            if (value) {
+                pendingSeat = 0;
+                promptBet();
+            } else {
+                endSession();
+            }
+            break;
+        case TABLE_OVER:
+            break;
+    }
+}
 
-        log << "=====================================" << endl;
+// Input that ends part way through a round leaves its bets on the table
+template <class Rules>
+void BasicBlackjackGame<Rules>::endSession() {
+    if (!frame.isQuiet()) {
+        ostringstream text;
+        displayHistory(text);
+        frame << text.str();
     }
+    tableState = TABLE_OVER;
 }
 
-// bet placing mechanic
-void BlackjackGame::placeBet(float& bet) {
-    cout << "Current balance: $" << fixed << setprecision(2) << balance << endl;
-    cout << "Place your bet: ";
-    cin >> bet;
-    while (bet < 5 || bet > balance) {
-        cout << "Invalid bet. Enter a valid amount (min $5, max your balance): ";
-        cin >> bet;
+template <class Rules>
+void BasicBlackjackGame<Rules>::endInput() {
+    if (tableState == TABLE_SEATS) {
+        tableState = TABLE_OVER;
+    } else if (tableState != TABLE_OVER) {
+        endSession();
     }
-    balance -= bet;
 }
 
-void BlackjackGame::playGame() {
-    bool playing = true;
-    int numPlayers;
+template <class Rules>
+void BasicBlackjackGame<Rules>::playGame() {
+    ConsoleInput console;
+    playSession(console);
+}
 
-    cout << "Enter the number of players (1-3): ";
-    cin >> numPlayers;
-    if (numPlayers < 1 || numPlayers > 3) {
-        cout << "Invalid number of players. Starting with 1 player." << endl;
-        numPlayers = 1;
+// Console output goes through the frame, which is flushed before every read
+template <class Rules>
+void BasicBlackjackGame<Rules>::playSession(SessionInput& input) {
+    startSession();
+    while (tableState != TABLE_OVER) {
+        frame.flush();
+        long long value;
+        bool answered = true;
+        if (tableState == TABLE_SEATS) {
+            int seatCount;
+            if (!input.seatCount(seatCount)) return;
+            value = seatCount;
+        } else if (tableState == TABLE_BET) {
+            answered = input.bet(pendingSeat, value);
+        } else if (tableState == TABLE_ACTION) {
+            int choice;
+            answered = input.action(pendingSeat, pendingHand, pendingDecisions, choice);
+            value = choice;
+        } else {
+            value = input.playAgain();
+        }
+        if (!answered) {
+            endSession();
+            break;
+        }
+        answer(value);
+        if (tableState == TABLE_PLAY_AGAIN) {
+            input.roundSettled(balance);
+        }
     }
+    frame.flush();
+}
 
-    initializePlayers(numPlayers);
-
-    while (playing) {
-        float bet;
-        placeBet(bet);
+template <class Rules>
+void BasicBlackjackGame<Rules>::promptBet() {
+    if (numSeats > 1) frame << "Player " << pendingSeat + 1 << ":\n";
+    frame << "Current balance: $" << balance / 100.0 << '\n';
+    frame << "Place your bet: ";
+    tableState = TABLE_BET;
+}
 
-        // Initial deal
-        for (int i = 0; i < numPlayers; ++i) {
-            Player& player = players.front();
-            player.clearHand();
-            player.addCard(deck.drawCard());
-            player.addCard(deck.drawCard());
-            cout << "Player " << i + 1 << "'s initial hand:" << endl;
-            player.showHand(false,0);
-            player.sortHand(0);
-            cout << "Player " << i + 1 << "'s sorted hand:" << endl;
-            player.showSortedHand(0);
-            players.push(player);
-            players.pop();
-        }
+// bet placing mechanic; bets are kept to the cent
+template <class Rules>
+void BasicBlackjackGame<Rules>::placeBet(long long wager) {
+    if (wager < MIN_BET || wager > balance) {
+        frame << "Invalid bet. Enter a valid amount (min $5, max your balance): ";
+        return;
+    }
+    balance -= wager;
+    totalWagered += wager;
+    seatWagers[pendingSeat][0] = wager;
+    seatWagers[pendingSeat][1] = 0;
+    if (++pendingSeat < numSeats) {
+        promptBet();
+    } else {
+        dealRound();
+    }
+}
 
-        Player house;
-        house.addCard(deck.drawCard());
-        house.addCard(deck.drawCard());
-        cout << "House's ";
-        house.showHand(true,0);
-
-        // Player decisions
-        queue<Player> tempQueue;
-        for (int i = 0; i < numPlayers; i++) {
-            Player player = players.front();
-            players.pop();
-
-            bool doneWithHands = false;
-            int currentHand = 0;
-            while (!doneWithHands) {
-                if (player.getNumberOfHands() == 2 && currentHand >= 2) {
-                    doneWithHands = true;
-                    break;
-                }
-                int hIndex = currentHand;
-
-                bool canSplit = false;
-                bool canDouble = false;
-
-                canSplit = (player.getNumberOfHands() < 2 && player.canSplit(hIndex));
-
-                int sz;
-                int* arr = player.getHandArray(hIndex, sz);
-                
-                int acesCount = 0;
-                int totalVal = 0;
-                for (int idx = 0; idx < sz; idx++) {
-                    int val = arr[idx];
-                    if (val == 1) {
-                        acesCount++;
-                        val = 11;
-                    } else if (val > 10) {
-                        val = 10;
-                    }
-                    totalVal += val;
-                }
-                while (totalVal > 21 && acesCount > 0) {
-                    totalVal -= 10;
-                    acesCount--;
-                }
+template <class Rules>
+void BasicBlackjackGame<Rules>::dealRound() {
+    PROFILE_COUNT(PROFILE_ROUNDS);
+
+    // Initial deal
+    for (int i = 0; i < numSeats; ++i) {
+        Player& player = seats[i];
+        player.clearHand();
+        player.addCard(deck.drawCard());
+        player.addCard(deck.drawCard());
+        frame << "Player " << i + 1 << "'s initial hand:\n";
+        player.showHand(frame, false, 0);
+        player.sortHand(0);
+        frame << "Player " << i + 1 << "'s sorted hand:\n";
+        player.showSortedHand(frame, 0);
+    }
 
-                bool allowDouble = false;
-                if (sz == 2 && !player.isDoubledDown(hIndex)) {
-                    if ((acesCount == 0 && (totalVal == 9 || totalVal == 10 || totalVal == 11)) ||
-                        (acesCount > 0 && (totalVal == 16 || totalVal == 17 || totalVal == 18))) {
-                        allowDouble = true;
-                    }
-                }
+    tableHouse.clearHand();
+    tableHouse.addCard(deck.drawCard());
+    tableHouse.addCard(deck.drawCard());
+    frame << "House's hand:\n";
+    tableHouse.showHand(frame, true, 0);
 
-                delete[] arr;
-                canDouble = allowDouble;
-
-                DecisionNode* head = DecisionTree::buildPlayerDecisionTree(canSplit, canDouble);
-
-                bool turnOver = false;
-                while (!turnOver && player.getScore(hIndex) <= 21) {
-                    cout << "Player's hand " << (hIndex+1) << ":" << endl;
-                    player.showHand(false,hIndex);
-                    cout << "Available actions:" << endl;
-
-                    DecisionNode* temp = head;
-                    int actionCount = 0;
-                    while (temp) {
-                        actionCount++;
-                        cout << actionCount << ". ";
-                        if (temp->action == ACTION_HIT) cout << "Hit" << endl;
-                        else if (temp->action == ACTION_STAND) cout << "Stand" << endl;
-                        else if (temp->action == ACTION_DOUBLE) cout << "Double Down" << endl;
-                        else if (temp->action == ACTION_SPLIT) cout << "Split" << endl;
-                        temp = temp->next;
-                    }
-
-                    cout << "Choose an action (1-" << actionCount << "): ";
-                    int choice;
-                    cin >> choice;
-                    if (choice < 1 || choice > actionCount) {
-                        cout << "Invalid choice. Try again." << endl;
-                        continue;
-                    }
-
-                    temp = head;
-                    for (int c = 1; c < choice; c++) {
-                        temp = temp->next;
-                    }
-
-                    ActionType chosenAction = temp->action;
-                    if (chosenAction == ACTION_HIT) {
-                        int card = deck.drawCard();
-                        player.addCard(card,hIndex);
-                        cout << "Dealt card:" << endl;
-                        char cardLines[6][7];
-                        getCardGraphic(card, cardLines);
-                        for (int line = 0; line < 6; ++line) {
-                            cout << cardLines[line] << endl;
-                        }
-                        player.showHand(false,hIndex);
-                        player.sortHand(hIndex);
-                        cout << "Sorted hand:" << endl;
-                        player.showSortedHand(hIndex);
-                        if (player.getScore(hIndex) > 21) {
-                            cout << "Player busts this hand!" << endl;
-                            turnOver = true;
-                        }
-                    } else if (chosenAction == ACTION_STAND) {
-                        turnOver = true;
-                    } else if (chosenAction == ACTION_DOUBLE) {
-                        if (balance >= bet) {
-                            balance -= bet;
-                            bet = bet * 2;
-                            player.setDoubledDown(hIndex,true);
-                            cout << "Doubling down! New bet: $" << bet << endl;
-                            int card = deck.drawCard();
-                            player.addCard(card,hIndex);
-                            cout << "Dealt card:" << endl;
-                            char cardLines[6][7];
-                            getCardGraphic(card, cardLines);
-                            for (int line = 0; line < 6; ++line) {
-                                cout << cardLines[line] << endl;
-                            }
-                            player.showHand(false,hIndex);
-                            player.sortHand(hIndex);
-                            cout << "Sorted hand:" << endl;
-                            player.showSortedHand(hIndex);
-                            turnOver = true;
-                        } else {
-                            cout << "Not enough balance to double down! Action not taken." << endl;
-                        }
-                    } else if (chosenAction == ACTION_SPLIT) {
-                        player.splitHand();
-                        cout << "Player splits the hand into two hands!" << endl;
-                        turnOver = true;
-                    }
-                }
+    pendingSeat = 0;
+    pendingHand = 0;
+    nextDecision(false);
+}
 
-                DecisionTree::destroyTree(head);
-                currentHand++;
-                if (player.getNumberOfHands() == 1 && currentHand == 1) {
-                    doneWithHands = true;
-                }
-                else if (player.getNumberOfHands() == 2 && currentHand == 2) {
-                    doneWithHands = true;
-                }
-            }
-            tempQueue.push(player);
+/* Moves on to the next hand that needs a decision, or to the house once
+   every seat is done. After a split the turn stays on the first hand,
+   then moves to the second. */
+template <class Rules>
+void BasicBlackjackGame<Rules>::nextDecision(bool turnOver) {
+    while (pendingSeat < numSeats) {
+        if (!turnOver && seats[pendingSeat].getScore(pendingHand) <= 21) {
+            promptAction();
+            return;
         }
+        if (++pendingHand >= seats[pendingSeat].getNumberOfHands()) {
+            pendingSeat++;
+            pendingHand = 0;
+        }
+        turnOver = false;
+    }
+    finishRound();
+}
 
-        players = tempQueue;
+template <class Rules>
+void BasicBlackjackGame<Rules>::promptAction() {
+    const Player& player = seats[pendingSeat];
+    {
+        PROFILE_SCOPE(PROFILE_DECISION);
+        bool canSplit = splitAllowed(player, pendingHand);
+        bool canDouble = doubleAllowed(player, pendingHand);
+        pendingDecisions = DecisionTable::playerDecisions(player.getHand(pendingHand),
+                                                          tableHouse.getHand(0).getCard(0), canSplit, canDouble);
+    }
+
+    frame << "Player " << pendingSeat + 1 << "'s hand " << (pendingHand + 1) << ":\n";
+    player.showHand(frame, false, pendingHand);
+    frame << "Available actions:\n";
+
+    for (int c = 0; c < pendingDecisions.count; c++) {
+        frame << c + 1 << ". ";
+        ActionType action = pendingDecisions.actions[c];
+        if (action == ACTION_HIT) frame << "Hit";
+        else if (action == ACTION_STAND) frame << "Stand";
+        else if (action == ACTION_DOUBLE) frame << "Double Down";
+        else if (action == ACTION_SPLIT) frame << "Split";
+        if (action == pendingDecisions.recommended) frame << " (basic strategy)";
+        frame << '\n';
+    }
 
-        cout << "House reveals second card." << endl;
-        house.showHand(false,0);
+    frame << "Choose an action (1-" << pendingDecisions.count << "): ";
+    tableState = TABLE_ACTION;
+}
+
+template <class Rules>
+void BasicBlackjackGame<Rules>::playAction(long long choice) {
+    if (choice < 1 || choice > pendingDecisions.count) {
+        frame << "Invalid choice. Try again.\n";
+        promptAction();
+        return;
+    }
 
-        bool houseTurn = true;
-        while (houseTurn && house.getScore(0) < 21) {
-            DecisionNode* hTree = DecisionTree::buildHouseDecisionTree(house.getScore(0));
-            if (hTree->action == ACTION_HIT) {
+    int i = pendingSeat;
+    int hIndex = pendingHand;
+    Player& player = seats[i];
+    bool turnOver = false;
+    ActionType chosenAction = pendingDecisions.actions[choice - 1];
+    if (chosenAction == ACTION_HIT) {
+        int card = deck.drawCard();
+        player.addCard(card,hIndex);
+        frame << "Dealt card:\n";
+        frame.appendCard(card);
+        player.showHand(frame, false, hIndex);
+        player.sortHand(hIndex);
+        frame << "Sorted hand:\n";
+        player.showSortedHand(frame, hIndex);
+        if (player.getScore(hIndex) > 21) {
+            frame << "Player busts this hand!\n";
+            turnOver = true;
+        }
+    } else if (chosenAction == ACTION_STAND) {
+        turnOver = true;
+    } else if (chosenAction == ACTION_DOUBLE) {
+        long long& wager = seatWagers[i][hIndex];
+        if (balance >= wager) {
+            balance -= wager;
+            totalWagered += wager;
+            wager = wager * 2;
+            player.setDoubledDown(hIndex,true);
+            PROFILE_COUNT(PROFILE_DOUBLES);
+            frame << "Doubling down! New bet: $" << wager / 100.0 << '\n';
+            int card = deck.drawCard();
+            player.addCard(card,hIndex);
+            frame << "Dealt card:\n";
+            frame.appendCard(card);
+            player.showHand(frame, false, hIndex);
+            player.sortHand(hIndex);
+            frame << "Sorted hand:\n";
+            player.showSortedHand(frame, hIndex);
+            turnOver = true;
+        } else {
+            frame << "Not enough balance to double down! Action not taken.\n";
+        }
+    } else if (chosenAction == ACTION_SPLIT) {
+        // The second hand carries its own bet, equal to the first
+        if (balance >= seatWagers[i][0]) {
+            seatWagers[i][1] = seatWagers[i][0];
+            balance -= seatWagers[i][1];
+            totalWagered += seatWagers[i][1];
+            player.splitHand();
+            PROFILE_COUNT(PROFILE_SPLITS);
+            frame << "Player splits the hand into two hands!\n";
+            // Each half gets a second card, and play goes on with the first
+            for (int h = 0; h < 2; h++) {
                 int card = deck.drawCard();
-                house.addCard(card,0);
-                cout << "House dealt card:" << endl;
-                char cardLines[6][7];
-                getCardGraphic(card, cardLines);
-                for (int line = 0; line < 6; ++line) {
-                    cout << cardLines[line] << endl;
-                }
-                house.showHand(false,0);
-            } else {
-                houseTurn = false;
+                player.addCard(card, h);
+                frame << "Hand " << h + 1 << " dealt card:\n";
+                frame.appendCard(card);
+                player.showHand(frame, false, h);
             }
-            DecisionTree::destroyTree(hTree);
-            if (house.getScore(0) >= 17) houseTurn = false;
+        } else {
+            frame << "Not enough balance to split! Action not taken.\n";
         }
+    }
+    nextDecision(turnOver);
+}
 
-        queue<Player> finalPlayers = players;
-        while (!finalPlayers.empty()) {
-            Player player = finalPlayers.front();
-            finalPlayers.pop();
-            for (int h = 0; h < player.getNumberOfHands(); h++) {
-                handleResult(player, house, bet, h);
-            }
+template <class Rules>
+void BasicBlackjackGame<Rules>::finishRound() {
+    frame << "House reveals second card.\n";
+    tableHouse.showHand(frame, false, 0);
+
+    {
+        PROFILE_SCOPE(PROFILE_HOUSE);
+        while (houseHits(tableHouse)) {
+            int card = deck.drawCard();
+            tableHouse.addCard(card,0);
+            frame << "House dealt card:\n";
+            frame.appendCard(card);
+            tableHouse.showHand(frame, false, 0);
         }
+    }
 
-        stats.displayStatistics();
+    settleRound(seats, seatWagers, numSeats, tableHouse);
 
-        cout << "Play again? (y/n): ";
-        char playAgain;
-        cin >> playAgain;
-        if (playAgain == 'n' || playAgain == 'N') {
-            playing = false;
-        }
+    if (!frame.isQuiet()) {
+        ostringstream text;
+        stats.displayStatistics(text);
+        frame << text.str();
     }
-
-    displayHistory();
+    frame << "Play again? (y/n): ";
+    tableState = TABLE_PLAY_AGAIN;
 }
 
-void BlackjackGame::handleResult(Player& player, Player& house, float& bet, int handIndex) {
+template <class Rules>
+long long BasicBlackjackGame<Rules>::handleResult(Player& player, Player& house, long long wager,
+                                                  int handIndex) {
+    PROFILE_SCOPE(PROFILE_SETTLE);
     int pScore = player.getScore(handIndex);
     int hScore = house.getScore(0);
-    int result;
+    unsigned flags = (player.hasBlackjack(handIndex) ? SETTLE_NATURAL : 0) |
+                     (house.hasBlackjack(0) ? SETTLE_HOUSE_NATURAL : 0);
+    int outcome;
+    long long payout = settleHand<Rules>(pScore, hScore, flags, wager, outcome);
+    return settleResult(player, handIndex, hScore, wager, outcome, payout);
+}
+
+/* The kernel settles the packed batch first; the per-hand bookkeeping then
+   runs over its results in seat and hand order. */
+template <class Rules>
+long long BasicBlackjackGame<Rules>::settleRound(Player* players, long long (*wagers)[2], int count,
+                                                 const Player& house) {
+    PROFILE_SCOPE(PROFILE_SETTLE);
+    int hScore = house.getScore(0);
+    unsigned char houseFlag = house.hasBlackjack(0) ? SETTLE_HOUSE_NATURAL : 0;
+    settlement.clear();
+    for (int i = 0; i < count; i++) {
+        for (int h = 0; h < players[i].getNumberOfHands(); h++) {
+            unsigned char flags = houseFlag | (players[i].hasBlackjack(h) ? SETTLE_NATURAL : 0);
+            settlement.add(players[i].getScore(h), hScore, flags, wagers[i][h]);
+        }
+    }
+    settleBatch<Rules>(settlement);
+
+    long long net = 0;
+    size_t hand = 0;
+    for (int i = 0; i < count; i++) {
+        for (int h = 0; h < players[i].getNumberOfHands(); h++, hand++) {
+            net += settleResult(players[i], h, hScore, settlement.wager[hand], settlement.outcome[hand],
+                                settlement.payout[hand]);
+        }
+    }
+    return net;
+}
+
+// Pay out a settled hand and record it everywhere; returns the net in cents
+template <class Rules>
+long long BasicBlackjackGame<Rules>::settleResult(const Player& player, int handIndex, int houseTotal,
+                                                  long long wager, int outcome, long long payout) {
+    PROFILE_COUNT(PROFILE_HANDS);
+    int pScore = player.getScore(handIndex);
+    long long net = payout - wager;
+    balance += payout;
+
+    LogOutcome logOutcome;
     if (pScore > 21) {
-        cout << "Player busts! House wins." << endl;
-        logResult("Player busts");
-        gameHistory[historyCount++] = -1;
-        stats.recordResult(-1);
-        result = -1;
-    } else if (hScore > 21) {
-        cout << "House busts! Player wins this hand!" << endl;
-        float winAmount = bet*2;
-        cout << "Player wins $" << winAmount << endl;
-        balance += winAmount;
-        logResult("House busts, player wins");
-        gameHistory[historyCount++] = 1;
-        stats.recordResult(1);
-        result = 1;
-    } else if (pScore > hScore) {
-        cout << "Player wins this hand!" << endl;
-        float winAmount = bet*2;
-        cout << "Player wins $" << winAmount << endl;
-        balance += winAmount;
-        logResult("Player wins");
-        gameHistory[historyCount++] = 1;
-        stats.recordResult(1);
-        result = 1;
-    } else if (pScore == hScore) {
-        cout << "It's a tie! House wins ties." << endl;
-        logResult("Tie goes to dealer");
-        gameHistory[historyCount++] = -1;
-        stats.recordResult(-1);
-        result = -1; // tie goes to dealer, considered a loss for player
-    } else {
-        cout << "House wins this hand." << endl;
-        logResult("House wins");
-        gameHistory[historyCount++] = -1;
-        stats.recordResult(-1);
-        result = -1;
-    }
-
-    // Use the hash function on the player's final hand
-    std::string finalHand = player.handToString(handIndex);
-    size_t hval = handHash(finalHand); // hashing the player's final hand
-
-    // This function will hash the player hand and save the performance of the hand along with it
-    // Needs improvements
-    int wins = (result == 1) ? 1 : 0;
-    int losses = ((result == -1) && (pScore != hScore)) ? 1 : 0;
-    int ties = ((pScore == hScore) && (pScore != 0)) ? 1 : 0;
-
-    // Results
-    handPerformance[hval][0] += wins;
-    handPerformance[hval][1] += losses;
-    handPerformance[hval][2] += ties;
-
-    // Log this performance data
-    if (log.is_open()) {
-        log << "Hand Hash: " << hval << " Final Hand: [" << finalHand << "] "
-            << "Wins: " << handPerformance[hval][0] 
-            << ", Losses: " << handPerformance[hval][1]
-            << ", Ties: " << handPerformance[hval][2] << endl;
-    }
-}
-
-// Game history
-void BlackjackGame::displayHistory() const {
-    cout << "Game History:" << endl;
-    for (int i = 0; i < historyCount; ++i) {
-        cout << "Game " << i + 1 << ": ";
-        if (gameHistory[i] == 1) {
-            cout << "Player wins" << endl;
-        } else if (gameHistory[i] == -1) {
-            cout << "House wins" << endl;
+        frame << "Player busts! House wins.\n";
+        logOutcome = LOG_PLAYER_BUSTS;
+    } else if (outcome == 1) {
+        if (houseTotal > 21) {
+            frame << "House busts! Player wins this hand!\n";
+            logOutcome = LOG_HOUSE_BUSTS;
         } else {
-            cout << "Tie" << endl;
+            frame << (payout > 2 * wager ? "Blackjack! Player wins this hand!\n" : "Player wins this hand!\n");
+            logOutcome = LOG_PLAYER_WINS;
         }
+        frame << "Player wins $" << payout / 100.0 << '\n';
+    } else if (outcome == 0) {
+        frame << "It's a tie! House wins ties.\n";
+        logOutcome = LOG_TIE;
+    } else {
+        frame << "House wins this hand.\n";
+        logOutcome = LOG_HOUSE_WINS;
     }
+    logHand(logOutcome, player, handIndex, houseTotal);
+    recordHistory(player, handIndex, houseTotal, outcome, net);
+    // Ties go to the dealer, so they count as losses here
+    stats.recordResult(outcome == 1 ? 1 : -1, net / 100.0);
+
+    // Save the performance of the player's final hand under its key
+    int wins = (outcome == 1) ? 1 : 0;
+    int losses = (outcome != 1 && pScore != houseTotal) ? 1 : 0;
+    int ties = (pScore == houseTotal && pScore != 0) ? 1 : 0;
+    handPerformance.record(player.getHand(handIndex).getKey(), wins, losses, ties);
+    return net;
 }
 
-// Save results in a log
-void BlackjackGame::logResult(const std::string& result) {
-    if (log.is_open()) {
-        log << "Result: " << result << ", Balance: $" << fixed << setprecision(2) << balance << endl;
-    } else {
-        cerr << "Error: Log file is not open." << endl;
+// Compact record of a settled hand; only wins pay, ties lose the bet
+template <class Rules>
+void BasicBlackjackGame<Rules>::recordHistory(const Player& player, int handIndex, int houseTotal, int outcome,
+                                              long long net) {
+    RoundHistory::Record record;
+    record.outcome = static_cast<signed char>(outcome);
+    record.flags = 0;
+    if (player.isDoubledDown(handIndex)) record.flags |= RoundHistory::HISTORY_DOUBLED;
+    if (player.getNumberOfHands() == 2) record.flags |= RoundHistory::HISTORY_SPLIT;
+    record.playerTotal = static_cast<unsigned char>(player.getScore(handIndex));
+    record.houseTotal = static_cast<unsigned char>(houseTotal);
+    record.net = static_cast<int>(net);
+    history.add(record);
+}
+
+// Game history, summarized in blocks so long sessions stay readable
+template <class Rules>
+void BasicBlackjackGame<Rules>::displayHistory(std::ostream& out) const {
+    static const long long MAX_SUMMARY_LINES = 20;
+    long long first = history.getFirstKept();
+    long long last = history.getTotal();
+    out << "Game History:\n";
+    if (first > 0) {
+        out << "(hands 1-" << first << " were dropped to stay under the history memory limit)\n";
     }
+
+    long long block = (last - first + MAX_SUMMARY_LINES - 1) / MAX_SUMMARY_LINES;
+    if (block < 10) block = 10;
+    long long wins = 0, losses = 0, ties = 0, doubled = 0, split = 0, net = 0;
+    for (long long start = first; start < last; start += block) {
+        long long end = (start + block < last) ? start + block : last;
+        long long blockWins = 0, blockLosses = 0, blockTies = 0, blockNet = 0;
+        for (long long hand = start; hand < end; hand++) {
+            const RoundHistory::Record& record = history.at(hand);
+            if (record.outcome == 1) blockWins++;
+            else if (record.outcome == -1) blockLosses++;
+            else blockTies++;
+            if (record.flags & RoundHistory::HISTORY_DOUBLED) doubled++;
+            if (record.flags & RoundHistory::HISTORY_SPLIT) split++;
+            blockNet += record.net;
+        }
+        out << "Hands " << start + 1 << "-" << end << ": " << blockWins << " won, " << blockLosses
+             << " lost, " << blockTies << " tied, net $" << fixed << setprecision(2) << blockNet / 100.0 << "\n";
+        wins += blockWins;
+        losses += blockLosses;
+        ties += blockTies;
+        net += blockNet;
+    }
+    out << (first > 0 ? "Kept hands: " : "Total: ") << wins << " won, " << losses << " lost, " << ties
+         << " tied, " << doubled << " doubled, " << split << " split hands, net $"
+         << fixed << setprecision(2) << net / 100.0 << endl;
+}
+
+template <class Rules>
+void BasicBlackjackGame<Rules>::setHistoryLimit(size_t limitBytes) {
+    history.setLimit(limitBytes);
 }
+
+// Attach this game to a binary log; each game gets its own channel
+template <class Rules>
+void BasicBlackjackGame<Rules>::setLog(LogWriter& writer) {
+    logChannel = writer.openChannel();
+}
+
+// Queue the settled hand for the log writer (the balance is already updated)
+template <class Rules>
+void BasicBlackjackGame<Rules>::logHand(LogOutcome outcome, const Player& player, int handIndex,
+                                        int houseTotal) {
+    if (!logChannel) return;
+    PROFILE_SCOPE(PROFILE_LOG);
+    const Hand& cards = player.getHand(handIndex);
+    LogRecord record;
+    record.outcome = outcome;
+    record.houseTotal = static_cast<unsigned char>(houseTotal);
+    record.cardCount = static_cast<unsigned char>(cards.getSize());
+    for (int i = 0; i < cards.getSize(); i++) {
+        record.cards[i] = static_cast<unsigned char>(cards.getCard(i));
+    }
+    record.balance = balance;
+    logChannel->push(record);
+}
+
+template class BasicBlackjackGame<StandardRules>;
+template class BasicBlackjackGame<RuntimeRules>;
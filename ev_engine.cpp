@@ -0,0 +1,336 @@
+#include "EVEngine.h"
+
+using namespace std;
+
+EVEngine::EVEngine() : remaining(0), upcardValue(0), exactDepth(FULLY_EXACT), removalDepth(0),
+                       frozenOdds(nullptr), frozenKey(0), houseScratch(HOUSE_SCRATCH_SIZE), scratchGeneration(0),
+                       scratchUsed(0), cacheHits(0), cacheMisses(0) {
+    for (int v = 0; v < 10; v++) {
+        counts[v] = 0;
+    }
+}
+
+void EVEngine::clearCache() {
+    houseCache.clear();
+    hitCache.clear();
+}
+
+// Six bits for each of ace to nine, eight for the ten-valued cards (up to 8 decks)
+std::uint64_t EVEngine::compositionKey() const {
+    std::uint64_t key = 0;
+    for (int v = 0; v < 9; v++) {
+        key = (key << 6) | static_cast<std::uint64_t>(counts[v]);
+    }
+    return (key << 8) | static_cast<std::uint64_t>(counts[9]);
+}
+
+// Add a card of value index v to a running total; false once the hand busts
+bool EVEngine::drawValue(int v, int& total, int& softAces) {
+    if (v == 0) {
+        total += 11;
+        softAces++;
+    } else {
+        total += v + 1;
+    }
+    while (total > 21 && softAces > 0) {
+        total -= 10;
+        softAces--;
+    }
+    return total <= 21;
+}
+
+/* Final-total distribution for the house from (total, softAces), drawing
+   without replacement. The house's remaining odds depend only on which
+   cards it has drawn, so each drawn multiset (four bits per value) is
+   expanded once per composition and memoized in a flat scratch table. */
+void EVEngine::houseFrom(int total, int softAces, std::uint64_t drawn, double out[6]) {
+    if (!RuntimeRules::houseHits(total, softAces > 0)) {
+        for (int i = 0; i < 6; i++) {
+            out[i] = 0.0;
+        }
+        out[total > 21 ? 5 : total - 17] = 1.0;
+        return;
+    }
+
+    size_t mask = houseScratch.size() - 1;
+    size_t slot = static_cast<size_t>((drawn * 0x9E3779B97F4A7C15ull) >> 40) & mask;
+    while (houseScratch[slot].generation == scratchGeneration) {
+        if (houseScratch[slot].drawn == drawn) {
+            for (int i = 0; i < 6; i++) {
+                out[i] = houseScratch[slot].p[i];
+            }
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    double odds[6] = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    double next[6];
+    int cardsLeft = remaining;
+    for (int v = 0; v < 10; v++) {
+        int c = counts[v];
+        if (c == 0) continue;
+        double q = static_cast<double>(c) / cardsLeft;
+        int newTotal = total;
+        int newSoft = softAces;
+        drawValue(v, newTotal, newSoft);
+        counts[v]--;
+        remaining--;
+        houseFrom(newTotal, newSoft, drawn + (1ull << (4 * v)), next);
+        counts[v]++;
+        remaining++;
+        for (int i = 0; i < 6; i++) {
+            odds[i] += q * next[i];
+        }
+    }
+
+    // Children may have filled slots, so probe again before storing
+    if (scratchUsed * 2 < houseScratch.size()) {
+        while (houseScratch[slot].generation == scratchGeneration) {
+            slot = (slot + 1) & mask;
+        }
+        houseScratch[slot].generation = scratchGeneration;
+        houseScratch[slot].drawn = drawn;
+        for (int i = 0; i < 6; i++) {
+            houseScratch[slot].p[i] = odds[i];
+        }
+        scratchUsed++;
+    }
+    for (int i = 0; i < 6; i++) {
+        out[i] = odds[i];
+    }
+}
+
+// House odds for the current composition, memoized by composition key
+const EVEngine::HouseOdds& EVEngine::houseOdds() {
+    StateKey key = { compositionKey(), 0, upcardValue };
+    std::unordered_map<StateKey, HouseOdds, StateKeyHash>::iterator it = houseCache.find(key);
+    if (it != houseCache.end()) {
+        cacheHits++;
+        return it->second;
+    }
+    cacheMisses++;
+
+    HouseOdds odds;
+    int total = 0;
+    int softAces = 0;
+    drawValue(upcardValue, total, softAces);
+    scratchGeneration++;
+    scratchUsed = 0;
+    houseFrom(total, softAces, 0, odds.p);
+    return houseCache.emplace(key, odds).first->second;
+}
+
+/* Called before drawing a player card. Once the removal depth reaches the
+   exact depth, the current house odds are frozen for the whole subtree. */
+const EVEngine::HouseOdds* EVEngine::enterDraw() {
+    const HouseOdds* saved = frozenOdds;
+    if (removalDepth == exactDepth) {
+        frozenOdds = &houseOdds();
+        frozenKey = compositionKey() + 1;
+    }
+    return saved;
+}
+
+void EVEngine::setExactDepth(int depth) {
+    if (depth != exactDepth) {
+        exactDepth = depth;
+        clearCache();
+    }
+}
+
+// Ties go to the house, so only a strictly higher total or a house bust wins
+double EVEngine::standEV(int total) {
+    const HouseOdds& odds = (removalDepth > exactDepth) ? *frozenOdds : houseOdds();
+    double win = odds.p[5];
+    for (int t = 17; t < total && t <= 21; t++) {
+        win += odds.p[t - 17];
+    }
+    return 2.0 * win - 1.0;
+}
+
+double EVEngine::bestEV(int total, int softAces, bool allowDouble) {
+    if (total > 21) return -1.0;
+    double best = standEV(total);
+    double hit = hitEV(total, softAces);
+    if (hit > best) best = hit;
+    // Only split hands are offered a double here
+    if (allowDouble && RuntimeRules::canDouble(total, softAces > 0, true)) {
+        double dbl = doubleEV(total, softAces);
+        if (dbl > best) best = dbl;
+    }
+    return best;
+}
+
+double EVEngine::hitEV(int total, int softAces) {
+    // Below the exact depth the value also depends on the frozen ancestor odds
+    StateKey key = { compositionKey(), (removalDepth > exactDepth) ? frozenKey : 0,
+                     (upcardValue << 8) | (total << 1) | (softAces > 0 ? 1 : 0) };
+    std::unordered_map<StateKey, double, StateKeyHash>::iterator it = hitCache.find(key);
+    if (it != hitCache.end()) {
+        cacheHits++;
+        return it->second;
+    }
+    cacheMisses++;
+
+    double ev = 0.0;
+    int cardsLeft = remaining;
+    const HouseOdds* savedOdds = enterDraw();
+    for (int v = 0; v < 10; v++) {
+        int c = counts[v];
+        if (c == 0) continue;
+        double p = static_cast<double>(c) / cardsLeft;
+        int newTotal = total;
+        int newSoft = softAces;
+        if (!drawValue(v, newTotal, newSoft)) {
+            ev -= p;
+            continue;
+        }
+        counts[v]--;
+        remaining--;
+        removalDepth++;
+        ev += p * bestEV(newTotal, newSoft, false);
+        removalDepth--;
+        counts[v]++;
+        remaining++;
+    }
+    frozenOdds = savedOdds;
+    hitCache.emplace(key, ev);
+    return ev;
+}
+
+// One card, then stand, for twice the stake
+double EVEngine::doubleEV(int total, int softAces) {
+    double ev = 0.0;
+    int cardsLeft = remaining;
+    const HouseOdds* savedOdds = enterDraw();
+    for (int v = 0; v < 10; v++) {
+        int c = counts[v];
+        if (c == 0) continue;
+        double p = static_cast<double>(c) / cardsLeft;
+        int newTotal = total;
+        int newSoft = softAces;
+        if (!drawValue(v, newTotal, newSoft)) {
+            ev -= p;
+            continue;
+        }
+        counts[v]--;
+        remaining--;
+        removalDepth++;
+        ev += p * standEV(newTotal);
+        removalDepth--;
+        counts[v]++;
+        remaining++;
+    }
+    frozenOdds = savedOdds;
+    return 2.0 * ev;
+}
+
+/* Each half starts from one pair card and draws its second card. Both
+   halves are valued on the same composition and the result doubled, an
+   approximation: the cards the first half takes before the second is
+   played are not removed. */
+double EVEngine::splitEV(int pairValue) {
+    int total = 0;
+    int softAces = 0;
+    drawValue(pairValue, total, softAces);
+
+    double ev = 0.0;
+    int cardsLeft = remaining;
+    const HouseOdds* savedOdds = enterDraw();
+    for (int v = 0; v < 10; v++) {
+        int c = counts[v];
+        if (c == 0) continue;
+        double p = static_cast<double>(c) / cardsLeft;
+        int newTotal = total;
+        int newSoft = softAces;
+        drawValue(v, newTotal, newSoft);
+        counts[v]--;
+        remaining--;
+        removalDepth++;
+        ev += p * bestEV(newTotal, newSoft, true);
+        removalDepth--;
+        counts[v]++;
+        remaining++;
+    }
+    frozenOdds = savedOdds;
+    return 2.0 * ev;
+}
+
+EVEngine::Result EVEngine::evaluate(const Hand& hand, int houseUpcard, const int unseenCounts[14],
+                                    bool canSplit, bool canDouble) {
+    counts[0] = unseenCounts[1];
+    for (int rank = 2; rank <= 9; rank++) {
+        counts[rank - 1] = unseenCounts[rank];
+    }
+    counts[9] = unseenCounts[10] + unseenCounts[11] + unseenCounts[12] + unseenCounts[13];
+    remaining = 0;
+    for (int v = 0; v < 10; v++) {
+        remaining += counts[v];
+    }
+    upcardValue = (houseUpcard > 10 ? 10 : houseUpcard) - 1;
+
+    if (houseCache.size() + hitCache.size() > MAX_CACHE_ENTRIES) {
+        clearCache();
+    }
+    removalDepth = 0;
+    frozenOdds = nullptr;
+
+    int total = hand.getTotal();
+    int softAces = hand.isSoft() ? 1 : 0;
+
+    Result result;
+    result.stand = standEV(total);
+    result.hit = hitEV(total, softAces);
+    result.doubleDown = canDouble ? doubleEV(total, softAces) : -2.0;
+    if (canSplit) {
+        int card = hand.getCard(0);
+        int pairValue = (card > 10 ? 10 : card) - 1;
+        result.split = splitEV(pairValue);
+    } else {
+        result.split = -2.0;
+    }
+
+    result.best = ACTION_STAND;
+    double best = result.stand;
+    if (result.hit > best) {
+        best = result.hit;
+        result.best = ACTION_HIT;
+    }
+    if (canDouble && result.doubleDown > best) {
+        best = result.doubleDown;
+        result.best = ACTION_DOUBLE;
+    }
+    if (canSplit && result.split > best) {
+        result.best = ACTION_SPLIT;
+    }
+    return result;
+}
+
+// EVStrategy implementation
+// House odds are recomputed at the decision point only: a cold fully exact query takes milliseconds
+EVStrategy::EVStrategy() {
+    engine.setExactDepth(0);
+    for (int rank = 0; rank < 14; rank++) {
+        unseen[rank] = 0;
+    }
+}
+
+long long EVStrategy::chooseBet(long long balance) {
+    (void)balance;
+    return BlackjackGame::MIN_BET;
+}
+
+void EVStrategy::observeShoe(const ShoeCounts& deck, int holeCard) {
+    for (int rank = 1; rank <= 13; rank++) {
+        unseen[rank] = deck.getRankCount(rank);
+    }
+    if (holeCard > 0) {
+        unseen[holeCard]++;
+    }
+}
+
+ActionType EVStrategy::chooseAction(const Player& player, int handIndex, int houseUpcard,
+                                    bool canSplit, bool canDouble) {
+    return engine.evaluate(player.getHand(handIndex), houseUpcard, unseen, canSplit, canDouble).best;
+}
@@ -0,0 +1,176 @@
+#include "HandBatch.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAND_BATCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+// Kernels
+/* Both kernels add one column of cards, one per hand. Under a house draw
+   only the hands the house would hit take theirs: below 17, and soft 17
+   as well under H17. They return how many hands took a card. */
+enum ColumnDraw {
+    DRAW_EVERY,
+    DRAW_S17,
+    DRAW_H17
+};
+
+static size_t addColumnScalar(size_t first, size_t n, const unsigned char* cards, ColumnDraw draw,
+                              std::int32_t* hard, std::int32_t* ace, std::int32_t* count, std::int32_t* total) {
+    size_t taken = 0;
+    for (size_t i = first; i < n; i++) {
+        bool hits = draw == DRAW_EVERY || total[i] < 17 ||
+                    (draw == DRAW_H17 && total[i] == 17 && total[i] != hard[i]);
+        int card = hits ? cards[i] : 0;
+        hard[i] += (card > 10) ? 10 : card;
+        ace[i] |= -static_cast<std::int32_t>(card == 1);
+        count[i] += (card != 0);
+        total[i] = hard[i] + (ace[i] & -static_cast<std::int32_t>(hard[i] <= 11) & 10);
+        taken += (card != 0);
+    }
+    return taken;
+}
+
+static void classifyScalar(size_t first, size_t n, const std::int32_t* hard, const std::int32_t* count,
+                           const std::int32_t* total, unsigned char* flags) {
+    for (size_t i = first; i < n; i++) {
+        flags[i] = static_cast<unsigned char>((total[i] != hard[i] ? HandBatch::HAND_SOFT : 0) |
+                                              (total[i] > 21 ? HandBatch::HAND_BUST : 0) |
+                                              (count[i] == 2 && total[i] == 21 ? HandBatch::HAND_BLACKJACK : 0));
+    }
+}
+
+#ifdef HAND_BATCH_AVX2
+__attribute__((target("avx2")))
+static size_t addColumnAvx2(size_t n, const unsigned char* cards, ColumnDraw draw,
+                            std::int32_t* hard, std::int32_t* ace, std::int32_t* count, std::int32_t* total) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i ten = _mm256_set1_epi32(10);
+    const __m256i twelve = _mm256_set1_epi32(12);
+    const __m256i seventeen = _mm256_set1_epi32(17);
+    size_t taken = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i card = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cards + i)));
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(total + i));
+        if (draw != DRAW_EVERY) {
+            __m256i hits = _mm256_cmpgt_epi32(seventeen, t);
+            if (draw == DRAW_H17) {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hard + i));
+                hits = _mm256_or_si256(hits, _mm256_andnot_si256(_mm256_cmpeq_epi32(t, h),
+                                                                 _mm256_cmpeq_epi32(t, seventeen)));
+            }
+            card = _mm256_and_si256(card, hits);
+        }
+        __m256i dealt = _mm256_cmpgt_epi32(card, zero);
+        __m256i h = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hard + i)),
+                                     _mm256_min_epi32(card, ten));
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(ace + i)),
+                                    _mm256_cmpeq_epi32(card, one));
+        __m256i c = _mm256_sub_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(count + i)), dealt);
+        __m256i soft = _mm256_and_si256(a, _mm256_cmpgt_epi32(twelve, h));
+        t = _mm256_add_epi32(h, _mm256_and_si256(soft, ten));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(hard + i), h);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ace + i), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(count + i), c);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(total + i), t);
+        taken += static_cast<size_t>(__builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(dealt))));
+    }
+    return taken + addColumnScalar(i, n, cards, draw, hard, ace, count, total);
+}
+
+// Flags are built as 32-bit lanes and narrowed to bytes, eight hands at a time
+__attribute__((target("avx2")))
+static void classifyAvx2(size_t n, const std::int32_t* hard, const std::int32_t* count,
+                         const std::int32_t* total, unsigned char* flags) {
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i twentyOne = _mm256_set1_epi32(21);
+    const __m256i softBit = _mm256_set1_epi32(HandBatch::HAND_SOFT);
+    const __m256i bustBit = _mm256_set1_epi32(HandBatch::HAND_BUST);
+    const __m256i blackjackBit = _mm256_set1_epi32(HandBatch::HAND_BLACKJACK);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(hard + i));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(count + i));
+        __m256i t = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(total + i));
+        __m256i soft = _mm256_andnot_si256(_mm256_cmpeq_epi32(t, h), softBit);
+        __m256i bust = _mm256_and_si256(_mm256_cmpgt_epi32(t, twentyOne), bustBit);
+        __m256i blackjack = _mm256_and_si256(_mm256_and_si256(_mm256_cmpeq_epi32(c, two),
+                                                              _mm256_cmpeq_epi32(t, twentyOne)), blackjackBit);
+        __m256i f = _mm256_or_si256(soft, _mm256_or_si256(bust, blackjack));
+        __m256i words = _mm256_packs_epi32(f, f);
+        __m256i packed = _mm256_packus_epi16(words, words);
+        int low = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+        int high = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+        memcpy(flags + i, &low, 4);
+        memcpy(flags + i + 4, &high, 4);
+    }
+    classifyScalar(i, n, hard, count, total, flags);
+}
+#endif
+
+// HandBatch implementation
+HandBatch::HandBatch(size_t hands) : vectorized(hasAvx2()) {
+    reset(hands);
+}
+
+bool HandBatch::hasAvx2() {
+#ifdef HAND_BATCH_AVX2
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+#else
+    return false;
+#endif
+}
+
+void HandBatch::reset(size_t hands) {
+    hard.assign(hands, 0);
+    ace.assign(hands, 0);
+    count.assign(hands, 0);
+    total.assign(hands, 0);
+}
+
+void HandBatch::addCards(const unsigned char* cards) {
+#ifdef HAND_BATCH_AVX2
+    if (vectorized) {
+        addColumnAvx2(size(), cards, DRAW_EVERY, hard.data(), ace.data(), count.data(), total.data());
+        return;
+    }
+#endif
+    addColumnScalar(0, size(), cards, DRAW_EVERY, hard.data(), ace.data(), count.data(), total.data());
+}
+
+int HandBatch::playHouse(const unsigned char* draws, int maxSteps, bool hitSoft17) {
+    ColumnDraw draw = hitSoft17 ? DRAW_H17 : DRAW_S17;
+    size_t n = size();
+    int steps = 0;
+    while (steps < maxSteps) {
+        const unsigned char* column = draws + static_cast<size_t>(steps) * n;
+        size_t taken;
+#ifdef HAND_BATCH_AVX2
+        if (vectorized) {
+            taken = addColumnAvx2(n, column, draw, hard.data(), ace.data(), count.data(), total.data());
+        } else
+#endif
+        {
+            taken = addColumnScalar(0, n, column, draw, hard.data(), ace.data(), count.data(), total.data());
+        }
+        if (taken == 0) break;
+        steps++;
+    }
+    return steps;
+}
+
+void HandBatch::classify(unsigned char* flags) const {
+#ifdef HAND_BATCH_AVX2
+    if (vectorized) {
+        classifyAvx2(size(), hard.data(), count.data(), total.data(), flags);
+        return;
+    }
+#endif
+    classifyScalar(0, size(), hard.data(), count.data(), total.data(), flags);
+}
@@ -0,0 +1,61 @@
+#include "InputSource.h"
+#include <cctype>
+
+using namespace std;
+
+// ScriptInput implementation
+bool ScriptInput::nextToken(std::string& token) {
+    while (pos < line.size() && isspace(static_cast<unsigned char>(line[pos]))) pos++;
+    if (pos == line.size() || line[pos] == '#') return false;
+    size_t start = pos;
+    while (pos < line.size() && !isspace(static_cast<unsigned char>(line[pos])) && line[pos] != '#') pos++;
+    token.assign(line, start, pos - start);
+    return true;
+}
+
+bool ScriptInput::hasAnswers(const std::string& line) {
+    size_t first = line.find_first_not_of(" \t\r\n");
+    return first != std::string::npos && line[first] != '#';
+}
+
+// CallbackInput implementation
+bool CallbackInput::askFor(InputQuestion question, int seat, int handIndex, const DecisionSet* decisions,
+                           long long& answer) {
+    InputRequest request = { question, seat, handIndex, decisions };
+    answer = 0;
+    return ask(request, answer);
+}
+
+bool CallbackInput::menuChoice(int& choice) {
+    long long answer;
+    if (!askFor(INPUT_MENU, 0, 0, nullptr, answer)) return false;
+    choice = static_cast<int>(answer);
+    return true;
+}
+
+bool CallbackInput::seatCount(int& seats) {
+    long long answer;
+    if (!askFor(INPUT_SEATS, 0, 0, nullptr, answer)) return false;
+    seats = static_cast<int>(answer);
+    return true;
+}
+
+bool CallbackInput::bet(int seat, long long& wager) {
+    return askFor(INPUT_BET, seat, 0, nullptr, wager);
+}
+
+bool CallbackInput::action(int seat, int handIndex, const DecisionSet& decisions, int& choice) {
+    long long answer;
+    if (!askFor(INPUT_ACTION, seat, handIndex, &decisions, answer)) return false;
+    choice = static_cast<int>(answer);
+    return true;
+}
+
+bool CallbackInput::playAgain() {
+    long long answer;
+    return askFor(INPUT_PLAY_AGAIN, 0, 0, nullptr, answer) && answer != 0;
+}
+
+void CallbackInput::roundSettled(long long balance) {
+    if (settled) settled(balance);
+}
@@ -0,0 +1,392 @@
+#include "LogAnalyzer.h"
+#include "LogWriter.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+// LogAnalysis implementation
+LogAnalysis::LogAnalysis() : chunks(0), sessions(0), detailedStates(0), balances(0), firstBalance(0), lastBalance(0),
+                             lowBalance(0), highBalance(0) {
+    for (int i = 0; i < ANALYSIS_OUTCOMES; i++) {
+        outcomes[i] = 0;
+    }
+}
+
+void LogAnalysis::addBalance(long long cents) {
+    if (balances == 0) {
+        firstBalance = lowBalance = highBalance = cents;
+    }
+    balances++;
+    lastBalance = cents;
+    if (cents < lowBalance) lowBalance = cents;
+    if (cents > highBalance) highBalance = cents;
+
+    if (trajectory.empty() || trajectory.back().results == SEGMENT_RESULTS) {
+        BalanceSegment segment = { 0, cents, cents, cents };
+        trajectory.push_back(segment);
+    }
+    BalanceSegment& segment = trajectory.back();
+    segment.results++;
+    segment.last = cents;
+    if (cents < segment.low) segment.low = cents;
+    if (cents > segment.high) segment.high = cents;
+}
+
+void LogAnalysis::merge(const LogAnalysis& later) {
+    chunks += later.chunks;
+    sessions += later.sessions;
+    detailedStates += later.detailedStates;
+    for (int i = 0; i < ANALYSIS_OUTCOMES; i++) {
+        outcomes[i] += later.outcomes[i];
+    }
+    if (later.balances > 0) {
+        if (balances == 0) {
+            firstBalance = later.firstBalance;
+            lowBalance = later.lowBalance;
+            highBalance = later.highBalance;
+        }
+        balances += later.balances;
+        lastBalance = later.lastBalance;
+        if (later.lowBalance < lowBalance) lowBalance = later.lowBalance;
+        if (later.highBalance > highBalance) highBalance = later.highBalance;
+        trajectory.insert(trajectory.end(), later.trajectory.begin(), later.trajectory.end());
+    }
+    hands.merge(later.hands);
+    for (unordered_map<std::uint64_t, std::string>::const_iterator it = later.handNames.begin();
+         it != later.handNames.end(); ++it) {
+        handNames.insert(*it);
+    }
+}
+
+// Text logs
+
+static bool startsWith(const char* begin, const char* end, const char* prefix, size_t length) {
+    return static_cast<size_t>(end - begin) >= length && memcmp(begin, prefix, length) == 0;
+}
+
+#define STARTS_WITH(begin, end, literal) startsWith(begin, end, literal, sizeof(literal) - 1)
+
+// "123.45" or "-5" to cents
+static bool parseCents(const char* pos, const char* end, long long& cents) {
+    bool negative = (pos < end && *pos == '-');
+    if (negative) pos++;
+    if (pos == end || *pos < '0' || *pos > '9') return false;
+    long long value = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9') {
+        value = value * 10 + (*pos++ - '0');
+    }
+    int fraction = 0, digits = 0;
+    if (pos < end && *pos == '.') {
+        for (pos++; pos < end && *pos >= '0' && *pos <= '9'; pos++) {
+            if (digits < 2) fraction = fraction * 10 + (*pos - '0');
+            digits++;
+        }
+    }
+    if (digits == 1) fraction *= 10;
+    value = value * 100 + fraction;
+    cents = negative ? -value : value;
+    return true;
+}
+
+// Every outcome text the game has written, old logs included
+static AnalysisOutcome classifyResult(const char* text, const char* end) {
+    if (STARTS_WITH(text, end, "Player wins") || STARTS_WITH(text, end, "House busts")) return ANALYSIS_WIN;
+    if (STARTS_WITH(text, end, "House wins") || STARTS_WITH(text, end, "Player busts")) return ANALYSIS_LOSS;
+    if (STARTS_WITH(text, end, "Tie")) return ANALYSIS_TIE;
+    return ANALYSIS_OTHER;
+}
+
+/* The Wins/Losses/Ties on a Hand Hash: line are the game's running totals
+   for that hand within one session, so they are not added up; the hand is
+   credited with the outcome of the Result: line just before it instead. */
+static void parseTextChunk(const char* pos, const char* end, LogAnalysis& analysis) {
+    int pending = -1;      // Outcome of the last result, until a hand claims it
+    while (pos < end) {
+        const char* newline = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        const char* next = newline ? newline + 1 : end;
+        const char* lineEnd = newline ? newline : end;
+        if (lineEnd > pos && lineEnd[-1] == '\r') lineEnd--;
+
+        switch (*pos) {
+            case 'R':
+                if (STARTS_WITH(pos, lineEnd, "Result: ")) {
+                    const char* text = pos + 8;
+                    const char* textEnd = lineEnd;
+                    const char* dollar = lineEnd;
+                    while (dollar > text && dollar[-1] != '$') dollar--;
+                    long long cents;
+                    bool hasBalance = dollar - text >= 12 && memcmp(dollar - 12, ", Balance: $", 12) == 0 &&
+                                      parseCents(dollar, lineEnd, cents);
+                    if (hasBalance) textEnd = dollar - 12;
+                    AnalysisOutcome outcome = classifyResult(text, textEnd);
+                    analysis.outcomes[outcome]++;
+                    pending = (outcome == ANALYSIS_OTHER) ? -1 : outcome;
+                    if (hasBalance) analysis.addBalance(cents);
+                }
+                break;
+            case 'H':
+                if (STARTS_WITH(pos, lineEnd, "Hand Hash: ") && pending >= 0) {
+                    const char* digit = pos + 11;
+                    std::uint64_t key = 0;
+                    while (digit < lineEnd && *digit >= '0' && *digit <= '9') {
+                        key = key * 10 + static_cast<std::uint64_t>(*digit++ - '0');
+                    }
+                    if (key == HandPerformanceTable::EMPTY_KEY) break;
+                    if (!analysis.hands.find(key)) {
+                        const char* open = static_cast<const char*>(
+                            memchr(digit, '[', static_cast<size_t>(lineEnd - digit)));
+                        const char* close = open ? static_cast<const char*>(
+                            memchr(open, ']', static_cast<size_t>(lineEnd - open))) : nullptr;
+                        if (close) {
+                            while (close > open + 1 && close[-1] == ' ') close--;
+                            analysis.handNames[key].assign(open + 1, close);
+                        }
+                    }
+                    analysis.hands.record(key, pending == ANALYSIS_WIN, pending == ANALYSIS_LOSS,
+                                          pending == ANALYSIS_TIE);
+                    pending = -1;
+                }
+                break;
+            case 'I':
+                if (STARTS_WITH(pos, lineEnd, "Initial balance: ")) analysis.sessions++;
+                break;
+            case 'D':
+                if (STARTS_WITH(pos, lineEnd, "Detailed game state:")) analysis.detailedStates++;
+                break;
+        }
+        pos = next;
+    }
+}
+
+// Start of the first Result: line at or after pos
+static const char* nextResultLine(const char* pos, const char* begin, const char* end) {
+    if (pos > begin && pos[-1] != '\n') {
+        const char* newline = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        pos = newline ? newline + 1 : end;
+    }
+    while (pos < end && !STARTS_WITH(pos, end, "Result: ")) {
+        const char* newline = static_cast<const char*>(memchr(pos, '\n', static_cast<size_t>(end - pos)));
+        pos = newline ? newline + 1 : end;
+    }
+    return pos;
+}
+
+// Binary logs
+
+static AnalysisOutcome recordOutcome(LogOutcome outcome) {
+    switch (outcome) {
+        case LOG_HOUSE_BUSTS:
+        case LOG_PLAYER_WINS:
+            return ANALYSIS_WIN;
+        case LOG_TIE:
+            return ANALYSIS_TIE;
+        default:
+            return ANALYSIS_LOSS;
+    }
+}
+
+// Hands are keyed and named the way convertLog writes them
+static bool parseBinaryChunk(const unsigned char* pos, const unsigned char* end, LogAnalysis& analysis) {
+    for (; pos + LOG_RECORD_SIZE <= end; pos += LOG_RECORD_SIZE) {
+        LogRecord record;
+        if (!decodeLogRecord(pos, record)) return false;
+        AnalysisOutcome outcome = recordOutcome(record.outcome);
+        analysis.outcomes[outcome]++;
+        analysis.addBalance(record.balance);
+
+        Hand hand;
+        for (int i = 0; i < record.cardCount; i++) {
+            hand.addCard(record.cards[i]);
+        }
+        std::uint64_t key = hand.getKey();
+        if (!analysis.hands.find(key)) {
+            std::string& name = analysis.handNames[key];
+            for (int i = 0; i < record.cardCount; i++) {
+                if (i > 0) name += ' ';
+                name += to_string(record.cards[i]);
+            }
+        }
+        analysis.hands.record(key, outcome == ANALYSIS_WIN, outcome == ANALYSIS_LOSS, outcome == ANALYSIS_TIE);
+    }
+    return true;
+}
+
+// Analysis
+
+/* Small logs are not worth a thread each. Chunk bounds are found first, on
+   the calling thread; each worker then owns one chunk and one result. */
+bool analyzeLogData(const char* data, size_t size, int threads, LogAnalysis& analysis) {
+    const size_t MIN_CHUNK = 1 << 20;
+    bool binary = size >= sizeof(LOG_MAGIC) && memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC)) == 0;
+    const char* begin = binary ? data + sizeof(LOG_MAGIC) : data;
+    const char* end = data + size;
+    size_t length = static_cast<size_t>(end - begin);
+    if (binary) length -= length % LOG_RECORD_SIZE;
+
+    size_t chunks = threads < 1 ? 1 : static_cast<size_t>(threads);
+    if (length / MIN_CHUNK + 1 < chunks) chunks = length / MIN_CHUNK + 1;
+    std::vector<const char*> bounds(chunks + 1, end);
+    bounds[0] = begin;
+    for (size_t c = 1; c < chunks; c++) {
+        size_t offset = length / chunks * c;
+        if (binary) {
+            bounds[c] = begin + offset - offset % LOG_RECORD_SIZE;
+        } else {
+            bounds[c] = nextResultLine(std::max(begin + offset, bounds[c - 1]), begin, end);
+        }
+    }
+    if (binary) bounds[chunks] = begin + length;
+
+    std::vector<LogAnalysis> parts(chunks);
+    std::vector<char> valid(chunks, 1);
+    std::vector<std::thread> workers;
+    for (size_t c = 0; c < chunks; c++) {
+        workers.push_back(std::thread([&, c]() {
+            parts[c].chunks = 1;
+            if (binary) {
+                valid[c] = parseBinaryChunk(reinterpret_cast<const unsigned char*>(bounds[c]),
+                                            reinterpret_cast<const unsigned char*>(bounds[c + 1]), parts[c]);
+            } else {
+                parseTextChunk(bounds[c], bounds[c + 1], parts[c]);
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    for (size_t c = 0; c < chunks; c++) {
+        if (!valid[c]) return false;
+        analysis.merge(parts[c]);
+    }
+    if (binary || size == 0) return true;
+    // Text that the game never wrote
+    long long lines = analysis.sessions + analysis.detailedStates;
+    for (int i = 0; i < ANALYSIS_OUTCOMES; i++) {
+        lines += analysis.outcomes[i];
+    }
+    return lines > 0;
+}
+
+static std::string dollars(long long cents) {
+    std::string sign = cents < 0 ? "-" : "";
+    long long value = cents < 0 ? -cents : cents;
+    std::string fraction = to_string(value % 100);
+    return sign + "$" + to_string(value / 100) + "." + (fraction.size() < 2 ? "0" : "") + fraction;
+}
+
+static double percent(long long part, long long whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+static bool playedMore(const HandPerformanceTable::Entry& a, const HandPerformanceTable::Entry& b) {
+    long long playedA = a.wins + a.losses + a.ties;
+    long long playedB = b.wins + b.losses + b.ties;
+    return playedA != playedB ? playedA > playedB : a.key < b.key;
+}
+
+static void reportAnalysis(const LogAnalysis& analysis, std::ostream& out) {
+    const size_t TRAJECTORY_ROWS = 20;
+    const size_t TOP_HANDS = 15;
+
+    long long settled = analysis.outcomes[ANALYSIS_WIN] + analysis.outcomes[ANALYSIS_LOSS] +
+                        analysis.outcomes[ANALYSIS_TIE];
+    out << "Sessions: " << analysis.sessions << ", detailed game states: " << analysis.detailedStates << endl;
+    out << fixed << setprecision(2);
+    out << "Results: " << settled + analysis.outcomes[ANALYSIS_OTHER] << " (" << settled << " hands settled)" << endl;
+    out << "Wins: " << analysis.outcomes[ANALYSIS_WIN] << " (" << percent(analysis.outcomes[ANALYSIS_WIN], settled)
+        << "%), losses: " << analysis.outcomes[ANALYSIS_LOSS] << " ("
+        << percent(analysis.outcomes[ANALYSIS_LOSS], settled) << "%), ties: " << analysis.outcomes[ANALYSIS_TIE]
+        << " (" << percent(analysis.outcomes[ANALYSIS_TIE], settled) << "%), other: "
+        << analysis.outcomes[ANALYSIS_OTHER] << endl;
+    if (analysis.balances == 0) return;
+
+    out << "Balance: first " << dollars(analysis.firstBalance) << ", final " << dollars(analysis.lastBalance)
+        << ", low " << dollars(analysis.lowBalance) << ", high " << dollars(analysis.highBalance) << endl;
+
+    // Whole segments are combined into rows, each ending where its last segment does
+    out << "Balance trajectory:" << endl;
+    out << right << setw(14) << "result" << setw(16) << "balance" << setw(16) << "low" << setw(16) << "high" << endl;
+    long long perRow = (analysis.balances + TRAJECTORY_ROWS - 1) / TRAJECTORY_ROWS;
+    long long seen = 0, nextRow = perRow;
+    long long low = 0, high = 0;
+    bool rowStarted = false;
+    for (size_t s = 0; s < analysis.trajectory.size(); s++) {
+        const BalanceSegment& segment = analysis.trajectory[s];
+        if (!rowStarted || segment.low < low) low = segment.low;
+        if (!rowStarted || segment.high > high) high = segment.high;
+        rowStarted = true;
+        seen += segment.results;
+        if (seen >= nextRow || s + 1 == analysis.trajectory.size()) {
+            out << setw(14) << seen << setw(16) << dollars(segment.last) << setw(16) << dollars(low)
+                << setw(16) << dollars(high) << endl;
+            while (nextRow <= seen) nextRow += perRow;
+            rowStarted = false;
+        }
+    }
+
+    std::vector<HandPerformanceTable::Entry> entries;
+    const std::vector<HandPerformanceTable::Entry>& slots = analysis.hands.getSlots();
+    for (size_t i = 0; i < slots.size(); i++) {
+        if (slots[i].key != HandPerformanceTable::EMPTY_KEY) entries.push_back(slots[i]);
+    }
+    if (entries.empty()) return;
+    size_t shown = std::min(entries.size(), TOP_HANDS);
+    partial_sort(entries.begin(), entries.begin() + shown, entries.end(), playedMore);
+    out << "Hands: " << entries.size() << " distinct, most played:" << endl;
+    out << right << setw(22) << "hash" << "  " << left << setw(20) << "final hand" << right << setw(12) << "played"
+        << setw(12) << "wins" << setw(12) << "losses" << setw(12) << "ties" << setw(9) << "win %" << endl;
+    for (size_t i = 0; i < shown; i++) {
+        const HandPerformanceTable::Entry& entry = entries[i];
+        unordered_map<std::uint64_t, std::string>::const_iterator name = analysis.handNames.find(entry.key);
+        long long played = entry.wins + entry.losses + entry.ties;
+        out << right << setw(22) << entry.key << "  " << left << setw(20)
+            << (name != analysis.handNames.end() ? name->second : "") << right << setw(12) << played
+            << setw(12) << entry.wins << setw(12) << entry.losses << setw(12) << entry.ties
+            << setw(9) << percent(entry.wins, played) << endl;
+    }
+}
+
+bool analyzeLog(const std::string& path, int threads, std::ostream& out) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+    size_t size = static_cast<size_t>(info.st_size);
+    const char* data = "";
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return false;
+        }
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapped);
+    }
+    ::close(fd);
+    bool binary = size >= sizeof(LOG_MAGIC) && memcmp(data, LOG_MAGIC, sizeof(LOG_MAGIC)) == 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    LogAnalysis analysis;
+    bool valid = analyzeLogData(data, size, threads, analysis);
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    if (size > 0) munmap(const_cast<char*>(data), size);
+    if (!valid) return false;
+
+    double megabytes = size / 1048576.0;
+    out << "Log: " << path << ", " << fixed << setprecision(1) << megabytes << " MB "
+        << (binary ? "binary" : "text") << ", analyzed in " << setprecision(3) << elapsed.count() << " s on "
+        << analysis.chunks << (analysis.chunks == 1 ? " thread (" : " threads (") << setprecision(0) << (elapsed.count() > 0 ? megabytes / elapsed.count() : 0) << " MB/s)" << endl;
+    reportAnalysis(analysis, out);
+    return true;
+}
@@ -0,0 +1,219 @@
+#include "LogWriter.h"
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace std;
+
+// Record encoding (little-endian, cards packed two to a byte)
+void encodeLogRecord(const LogRecord& record, unsigned char out[LOG_RECORD_SIZE]) {
+    memset(out, 0, LOG_RECORD_SIZE);
+    out[0] = record.outcome;
+    out[1] = record.houseTotal;
+    out[2] = record.cardCount;
+    for (int i = 0; i < record.cardCount; i++) {
+        out[3 + i / 2] |= static_cast<unsigned char>(record.cards[i] << (4 * (i % 2)));
+    }
+    std::uint64_t bits = static_cast<std::uint64_t>(record.balance);
+    for (int i = 0; i < 8; i++) {
+        out[14 + i] = static_cast<unsigned char>(bits >> (8 * i));
+    }
+}
+
+bool decodeLogRecord(const unsigned char in[LOG_RECORD_SIZE], LogRecord& record) {
+    if (in[0] > LOG_HOUSE_WINS || in[2] > Hand::MAX_CARDS) return false;
+    record.outcome = static_cast<LogOutcome>(in[0]);
+    record.houseTotal = in[1];
+    record.cardCount = in[2];
+    for (int i = 0; i < record.cardCount; i++) {
+        record.cards[i] = (in[3 + i / 2] >> (4 * (i % 2))) & 0x0F;
+        // Ranks run from 1 (ace) to 13 (king)
+        if (record.cards[i] < 1 || record.cards[i] > 13) return false;
+    }
+    std::uint64_t bits = 0;
+    for (int i = 0; i < 8; i++) {
+        bits |= static_cast<std::uint64_t>(in[14 + i]) << (8 * i);
+    }
+    record.balance = static_cast<long long>(bits);
+    return true;
+}
+
+// LogChannel implementation
+size_t LogChannel::pop(LogRecord* out, size_t max) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t available = head.load(std::memory_order_acquire) - t;
+    if (available > max) available = max;
+    for (size_t i = 0; i < available; i++) {
+        out[i] = ring[(t + i) & (CAPACITY - 1)];
+    }
+    tail.store(t + available, std::memory_order_release);
+    return available;
+}
+
+// LogWriter implementation
+LogWriter::LogWriter() : fd(-1), running(false), channelCount(0), recordsWritten(0) {
+    for (int i = 0; i < MAX_CHANNELS; i++) {
+        channels[i].store(nullptr);
+    }
+}
+
+LogWriter::~LogWriter() {
+    close();
+}
+
+bool LogWriter::open(const std::string& path) {
+    close();
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) return false;
+    off_t size = lseek(fd, 0, SEEK_END);
+    bool ready;
+    if (size == 0) {
+        ready = writeAll(reinterpret_cast<const unsigned char*>(LOG_MAGIC), sizeof(LOG_MAGIC));
+    } else {
+        // Only a binary log is appended to; a record cut short by a crash is dropped
+        char magic[sizeof(LOG_MAGIC)];
+        off_t records = (size - static_cast<off_t>(sizeof(LOG_MAGIC))) / LOG_RECORD_SIZE;
+        off_t whole = static_cast<off_t>(sizeof(LOG_MAGIC)) + records * LOG_RECORD_SIZE;
+        ready = size >= static_cast<off_t>(sizeof(LOG_MAGIC)) &&
+                pread(fd, magic, sizeof(magic), 0) == static_cast<ssize_t>(sizeof(magic)) &&
+                memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC)) == 0 && (whole == size || ftruncate(fd, whole) == 0);
+    }
+    if (!ready) {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    running.store(true, std::memory_order_release);
+    worker = std::thread(&LogWriter::run, this);
+    return true;
+}
+
+// Producers must be done pushing; whatever is queued is still written
+void LogWriter::close() {
+    if (fd < 0) return;
+    running.store(false, std::memory_order_release);
+    worker.join();
+    ::close(fd);
+    fd = -1;
+    int count = channelCount.load();
+    if (count > MAX_CHANNELS) count = MAX_CHANNELS;
+    for (int i = 0; i < count; i++) {
+        delete channels[i].exchange(nullptr);
+    }
+    channelCount.store(0);
+}
+
+LogChannel* LogWriter::openChannel() {
+    if (fd < 0) return nullptr;
+    int index = channelCount.fetch_add(1);
+    if (index >= MAX_CHANNELS) return nullptr;
+    LogChannel* channel = new LogChannel();
+    channels[index].store(channel, std::memory_order_release);
+    return channel;
+}
+
+// Writer thread: drain every channel, sleep briefly when all are empty
+void LogWriter::run() {
+    std::vector<LogRecord> batch(BATCH_RECORDS);
+    std::vector<unsigned char> bytes(BATCH_RECORDS * LOG_RECORD_SIZE);
+    while (running.load(std::memory_order_acquire)) {
+        if (drain(batch.data(), bytes.data()) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+    while (drain(batch.data(), bytes.data()) > 0) {
+    }
+}
+
+// One write per batch of up to BATCH_RECORDS records
+size_t LogWriter::drain(LogRecord* batch, unsigned char* bytes) {
+    size_t total = 0;
+    int count = channelCount.load(std::memory_order_acquire);
+    if (count > MAX_CHANNELS) count = MAX_CHANNELS;
+    for (int i = 0; i < count; i++) {
+        LogChannel* channel = channels[i].load(std::memory_order_acquire);
+        if (!channel) continue;
+        size_t n = channel->pop(batch, BATCH_RECORDS);
+        for (size_t r = 0; r < n; r++) {
+            encodeLogRecord(batch[r], bytes + r * LOG_RECORD_SIZE);
+        }
+        if (n > 0 && writeAll(bytes, n * LOG_RECORD_SIZE)) {
+            recordsWritten.fetch_add(static_cast<long long>(n), std::memory_order_relaxed);
+        }
+        total += n;
+    }
+    return total;
+}
+
+bool LogWriter::writeAll(const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) return false;
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Conversion back to text
+
+static const char* outcomeText(LogOutcome outcome) {
+    switch (outcome) {
+        case LOG_PLAYER_BUSTS:
+            return "Player busts";
+        case LOG_HOUSE_BUSTS:
+            return "House busts, player wins";
+        case LOG_PLAYER_WINS:
+            return "Player wins";
+        case LOG_TIE:
+            return "Tie goes to dealer";
+        default:
+            return "House wins";
+    }
+}
+
+/* The running per-hand totals in the text log are rebuilt by replaying the
+   records in order, the same way handleResult accumulates them. The hand's
+   key (its packed rank counts) is printed where the text log had a hash. */
+bool convertLog(const std::string& path, std::ostream& out) {
+    ifstream in(path.c_str(), ios::binary);
+    char magic[sizeof(LOG_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, LOG_MAGIC, sizeof(LOG_MAGIC)) != 0) {
+        return false;
+    }
+
+    HandPerformanceTable handPerformance;
+    std::vector<char> bytes(4096 * LOG_RECORD_SIZE);
+    out << fixed << setprecision(2);
+    while (in) {
+        in.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        size_t records = static_cast<size_t>(in.gcount()) / LOG_RECORD_SIZE;
+        for (size_t r = 0; r < records; r++) {
+            LogRecord record;
+            if (!decodeLogRecord(reinterpret_cast<const unsigned char*>(bytes.data()) + r * LOG_RECORD_SIZE,
+                                 record)) {
+                return false;
+            }
+            out << "Result: " << outcomeText(record.outcome) << ", Balance: $" << record.balance / 100.0 << '\n';
+
+            Hand hand;
+            for (int i = 0; i < record.cardCount; i++) {
+                hand.addCard(record.cards[i]);
+            }
+            out << "Hand Hash: " << hand.getKey() << " Final Hand: [";
+            for (int i = 0; i < record.cardCount; i++) {
+                out << static_cast<int>(record.cards[i]) << ' ';
+            }
+            int pScore = hand.getTotal();
+            int hScore = record.houseTotal;
+            bool won = (record.outcome == LOG_HOUSE_BUSTS || record.outcome == LOG_PLAYER_WINS);
+            handPerformance.record(hand.getKey(), won ? 1 : 0, (!won && pScore != hScore) ? 1 : 0,
+                                   (pScore == hScore && pScore != 0) ? 1 : 0);
+            const HandPerformanceTable::Entry* perf = handPerformance.find(hand.getKey());
+            out << "] Wins: " << perf->wins << ", Losses: " << perf->losses << ", Ties: " << perf->ties << '\n';
+        }
+    }
+    return true;
+}
@@ -14,7 +14,7 @@ GREP=grep
 NM=nm
 CCADMIN=CCadmin
 RANLIB=ranlib
-CC=gcc
+CC=g++
 CCC=g++
 CXX=g++
 FC=gfortran
@@ -36,11 +36,24 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 # Object Files
 OBJECTFILES= \
 	${OBJECTDIR}/blackjack.o \
-	${OBJECTDIR}/blackjack_functions.o
+	${OBJECTDIR}/blackjack_functions.o \
+	${OBJECTDIR}/simulation.o \
+	${OBJECTDIR}/strategy_table.o \
+	${OBJECTDIR}/ev_engine.o \
+	${OBJECTDIR}/log_writer.o \
+	${OBJECTDIR}/settlement.o \
+	${OBJECTDIR}/hand_batch.o \
+	${OBJECTDIR}/shoe_pipeline.o \
+	${OBJECTDIR}/strategy_generator.o \
+	${OBJECTDIR}/profiler.o \
+	${OBJECTDIR}/replay.o \
+	${OBJECTDIR}/log_analyzer.o \
+	${OBJECTDIR}/input_source.o \
+	${OBJECTDIR}/table_server.o
 
 
 # C Compiler Flags
-CFLAGS=
+CFLAGS=-pthread
 
 # CC Compiler Flags
 CCFLAGS=
@@ -53,7 +66,7 @@ FFLAGS=
 ASFLAGS=
 
 # Link Libraries and Options
-LDLIBSOPTIONS=
+LDLIBSOPTIONS=-pthread
 
 # Build Targets
 .build-conf: ${BUILD_SUBPROJECTS}
@@ -73,6 +86,71 @@ ${OBJECTDIR}/blackjack_functions.o: blackjack_functions.cpp
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/blackjack_functions.o blackjack_functions.cpp
 
+${OBJECTDIR}/simulation.o: simulation.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/simulation.o simulation.cpp
+
+${OBJECTDIR}/strategy_table.o: strategy_table.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/strategy_table.o strategy_table.cpp
+
+${OBJECTDIR}/ev_engine.o: ev_engine.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/ev_engine.o ev_engine.cpp
+
+${OBJECTDIR}/log_writer.o: log_writer.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/log_writer.o log_writer.cpp
+
+${OBJECTDIR}/settlement.o: settlement.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/settlement.o settlement.cpp
+
+${OBJECTDIR}/hand_batch.o: hand_batch.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/hand_batch.o hand_batch.cpp
+
+${OBJECTDIR}/shoe_pipeline.o: shoe_pipeline.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/shoe_pipeline.o shoe_pipeline.cpp
+
+${OBJECTDIR}/strategy_generator.o: strategy_generator.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/strategy_generator.o strategy_generator.cpp
+
+${OBJECTDIR}/profiler.o: profiler.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/profiler.o profiler.cpp
+
+${OBJECTDIR}/replay.o: replay.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/replay.o replay.cpp
+
+${OBJECTDIR}/log_analyzer.o: log_analyzer.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/log_analyzer.o log_analyzer.cpp
+
+${OBJECTDIR}/input_source.o: input_source.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/input_source.o input_source.cpp
+
+${OBJECTDIR}/table_server.o: table_server.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.c) -O2 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/table_server.o table_server.cpp
+
 # Subprojects
 .build-subprojects:
 
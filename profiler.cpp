@@ -0,0 +1,144 @@
+#include "Profiler.h"
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+#ifdef BLACKJACK_PROFILE
+
+static const char* const PHASE_NAMES[PROFILE_PHASES] = {
+    "draw", "reshuffle", "decision", "house", "settle", "log", "render"
+};
+
+static const char* const COUNTER_NAMES[PROFILE_COUNTERS] = {
+    "rounds", "hands", "doubles", "splits"
+};
+
+namespace profiler {
+
+/* Blocks are never freed, so a worker's counters are still there when the
+   report runs after it has exited. A thread that exits hands its block
+   back and the next new thread carries on adding to it, so the simulator
+   starting workers for every batch does not grow the registry. The clock
+   reading taken with the first block is used to turn time-stamp ticks
+   into nanoseconds. */
+struct Registry {
+    std::mutex lock;
+    std::vector<ThreadCounters*> blocks;
+    std::vector<ThreadCounters*> spare;     // Blocks of threads that have exited
+    std::uint64_t startTicks;
+    chrono::steady_clock::time_point startTime;
+
+    Registry() : startTicks(now()), startTime(chrono::steady_clock::now()) {}
+};
+
+static Registry& registry() {
+    static Registry instance;
+    return instance;
+}
+
+// Returns the thread's block to the registry when the thread exits
+struct ThreadExit {
+    ThreadCounters* counters;
+
+    ThreadExit() : counters(nullptr) {}
+    ~ThreadExit() {
+        if (!counters) return;
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> guard(reg.lock);
+        reg.spare.push_back(counters);
+    }
+};
+
+ThreadCounters& registerThread() {
+    static thread_local ThreadExit owner;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+    if (reg.spare.empty()) {
+        reg.blocks.push_back(new ThreadCounters());
+        reg.spare.push_back(reg.blocks.back());
+    }
+    owner.counters = reg.spare.back();
+    reg.spare.pop_back();
+    return *owner.counters;
+}
+
+// Lowest tick count that falls in bucket b
+static double bucketStart(int b) {
+    if (b < SUB_BUCKETS) return b;
+    int log = b / SUB_BUCKETS + 2;
+    int step = b % SUB_BUCKETS;
+    return static_cast<double>((std::uint64_t(SUB_BUCKETS) + step) << (log - 3));
+}
+
+// Ticks at quantile q, from the middle of the bucket it falls in
+static double quantile(const PhaseCounters& phase, double q) {
+    std::uint64_t target = static_cast<std::uint64_t>(q * (phase.calls - 1)) + 1;
+    std::uint64_t seen = 0;
+    for (int b = 0; b < BUCKETS; b++) {
+        seen += phase.histogram[b];
+        if (seen >= target) {
+            return (bucketStart(b) + bucketStart(b + 1)) / 2;
+        }
+    }
+    return 0.0;
+}
+
+}
+
+void profileReport(std::ostream& out) {
+    using namespace profiler;
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> guard(reg.lock);
+
+    ThreadCounters total = ThreadCounters();
+    for (size_t t = 0; t < reg.blocks.size(); t++) {
+        const ThreadCounters& counters = *reg.blocks[t];
+        for (int p = 0; p < PROFILE_PHASES; p++) {
+            total.phases[p].calls += counters.phases[p].calls;
+            total.phases[p].ticks += counters.phases[p].ticks;
+            for (int b = 0; b < BUCKETS; b++) {
+                total.phases[p].histogram[b] += counters.phases[p].histogram[b];
+            }
+        }
+        for (int c = 0; c < PROFILE_COUNTERS; c++) {
+            total.counters[c] += counters.counters[c];
+        }
+    }
+
+#ifdef PROFILE_TSC
+    chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - reg.startTime;
+    std::uint64_t ticks = now() - reg.startTicks;
+    double nsPerTick = ticks > 0 ? elapsed.count() / ticks : 0.0;
+#else
+    double nsPerTick = 1e9 * chrono::steady_clock::period::num / chrono::steady_clock::period::den;
+#endif
+
+    out << "Profile (per call; a phase includes the phases it calls):" << endl;
+    out << left << setw(11) << "phase" << right << setw(14) << "calls" << setw(16) << "total ms"
+        << setw(12) << "mean ns" << setw(12) << "p50 ns" << setw(12) << "p99 ns" << endl;
+    out << fixed;
+    for (int p = 0; p < PROFILE_PHASES; p++) {
+        const PhaseCounters& phase = total.phases[p];
+        if (phase.calls == 0) continue;
+        double totalNs = phase.ticks * nsPerTick;
+        out << left << setw(11) << PHASE_NAMES[p] << right << setw(14) << phase.calls
+            << setw(16) << setprecision(3) << totalNs / 1e6
+            << setw(12) << setprecision(1) << totalNs / phase.calls
+            << setw(12) << quantile(phase, 0.50) * nsPerTick
+            << setw(12) << quantile(phase, 0.99) * nsPerTick << endl;
+    }
+    for (int c = 0; c < PROFILE_COUNTERS; c++) {
+        out << COUNTER_NAMES[c] << ": " << total.counters[c] << (c + 1 < PROFILE_COUNTERS ? ", " : "\n");
+    }
+}
+
+#else
+
+void profileReport(std::ostream& out) {
+    out << "Profiling is not compiled into this build; build it with 'make profile'." << endl;
+}
+
+#endif
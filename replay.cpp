@@ -0,0 +1,343 @@
+#include "Replay.h"
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <thread>
+
+using namespace std;
+
+static const char* const EVENT_NAMES[] = {
+    "nothing", "the seat count", "a bet", "an action", "play again", "quit", "a settled round"
+};
+
+static bool hasValue(unsigned event) {
+    return event == REPLAY_SEATS || event == REPLAY_BET || event == REPLAY_ACTION || event == REPLAY_SETTLED;
+}
+
+// Zigzag varints: small numbers of either sign take one byte
+static void appendVarint(std::string& out, long long value) {
+    std::uint64_t bits = (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+    while (bits >= 0x80) {
+        out.push_back(static_cast<char>((bits & 0x7F) | 0x80));
+        bits >>= 7;
+    }
+    out.push_back(static_cast<char>(bits));
+}
+
+static bool readVarint(const unsigned char*& pos, const unsigned char* end, long long& value) {
+    std::uint64_t bits = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (pos == end) return false;
+        unsigned char byte = *pos++;
+        bits |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            value = static_cast<long long>((bits >> 1) ^ (~(bits & 1) + 1));
+            return true;
+        }
+    }
+    return false;
+}
+
+static void encodeRules(const RuleSet& rules, unsigned char out[8]) {
+    out[0] = static_cast<unsigned char>(rules.decks);
+    out[1] = static_cast<unsigned char>(rules.penetration);
+    out[2] = rules.hitSoft17;
+    out[3] = static_cast<unsigned char>(rules.blackjackPays[0]);
+    out[4] = static_cast<unsigned char>(rules.blackjackPays[1]);
+    out[5] = rules.doubleAnyTwo;
+    out[6] = rules.doubleAfterSplit;
+    out[7] = rules.split;
+}
+
+static RuleSet decodeRules(const unsigned char in[8]) {
+    RuleSet rules;
+    rules.decks = in[0];
+    rules.penetration = in[1];
+    rules.hitSoft17 = in[2] != 0;
+    rules.blackjackPays[0] = in[3];
+    rules.blackjackPays[1] = in[4];
+    rules.doubleAnyTwo = in[5] != 0;
+    rules.doubleAfterSplit = in[6] != 0;
+    rules.split = in[7] != 0;
+    return rules;
+}
+
+// SessionRecorder implementation
+SessionRecorder::SessionRecorder(SessionInput& input, std::uint64_t seed, const RuleSet& rules)
+    : input(input), seed(seed), rules(rules) {}
+
+SessionRecorder::~SessionRecorder() {
+    write();
+}
+
+bool SessionRecorder::open(const std::string& path) {
+    file.open(path.c_str(), ios::binary | ios::app);
+    if (!file) return false;
+    unsigned char header[24];
+    memcpy(header, REPLAY_MAGIC, 8);
+    for (int i = 0; i < 8; i++) {
+        header[8 + i] = static_cast<unsigned char>(seed >> (8 * i));
+    }
+    encodeRules(rules, header + 16);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+    file.flush();
+    return static_cast<bool>(file);
+}
+
+void SessionRecorder::record(ReplayEvent event, long long value) {
+    pending.push_back(static_cast<char>(event));
+    if (hasValue(event)) appendVarint(pending, value);
+}
+
+void SessionRecorder::write() {
+    if (file.is_open() && !pending.empty()) {
+        file.write(pending.data(), static_cast<std::streamsize>(pending.size()));
+        file.flush();
+    }
+    pending.clear();
+}
+
+bool SessionRecorder::seatCount(int& seats) {
+    if (!input.seatCount(seats)) return false;
+    record(REPLAY_SEATS, seats);
+    return true;
+}
+
+bool SessionRecorder::bet(int seat, long long& wager) {
+    if (!input.bet(seat, wager)) return false;
+    record(REPLAY_BET, wager);
+    return true;
+}
+
+bool SessionRecorder::action(int seat, int handIndex, const DecisionSet& decisions, int& choice) {
+    if (!input.action(seat, handIndex, decisions, choice)) return false;
+    record(REPLAY_ACTION, choice);
+    return true;
+}
+
+bool SessionRecorder::playAgain() {
+    bool again = input.playAgain();
+    record(again ? REPLAY_PLAY_AGAIN : REPLAY_QUIT, 0);
+    return again;
+}
+
+// The round is complete, so it goes to disk in one write
+void SessionRecorder::roundSettled(long long balance) {
+    input.roundSettled(balance);
+    record(REPLAY_SETTLED, balance);
+    write();
+}
+
+// Recording files
+bool readRecording(const std::string& path, std::vector<RecordedSession>& sessions) {
+    ifstream in(path.c_str(), ios::binary);
+    if (!in) return false;
+    std::vector<unsigned char> data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    const unsigned char* pos = data.data();
+    const unsigned char* end = pos + data.size();
+    int index = 0;
+    while (pos < end) {
+        // Every session opens with the magic, and no event starts with its first byte
+        if (end - pos < 24 || memcmp(pos, REPLAY_MAGIC, 8) != 0) return false;
+        RecordedSession session;
+        session.source = path;
+        session.index = ++index;
+        session.seed = 0;
+        for (int i = 0; i < 8; i++) {
+            session.seed |= static_cast<std::uint64_t>(pos[8 + i]) << (8 * i);
+        }
+        // Rules out of bounds would build a shoe or a payout the game cannot hold
+        session.rules = decodeRules(pos + 16);
+        if (!session.rules.isValid()) return false;
+        pos += 24;
+        const unsigned char* first = pos;
+        while (pos < end && *pos != static_cast<unsigned char>(REPLAY_MAGIC[0])) {
+            unsigned event = *pos++;
+            if (event < REPLAY_SEATS || event > REPLAY_SETTLED) return false;
+            long long value;
+            if (hasValue(event) && !readVarint(pos, end, value)) return false;
+        }
+        session.events.assign(first, pos);
+        sessions.push_back(session);
+    }
+    return true;
+}
+
+// Replay
+/* Hands the recorded answers back in order. An answer asked for out of
+   turn or a checkpoint that does not match marks the session diverged
+   and ends it; running out of answers ends it the way the recorded
+   session ended. */
+class ReplayInput : public SessionInput {
+public:
+    explicit ReplayInput(const std::vector<unsigned char>& events)
+        : pos(events.data()), end(events.data() + events.size()), rounds(0), diverged(false) {}
+
+    bool seatCount(int& seats) {
+        long long value;
+        if (!next(REPLAY_SEATS, value)) return false;
+        seats = static_cast<int>(value);
+        return true;
+    }
+
+    bool bet(int seat, long long& wager) {
+        (void)seat;
+        return next(REPLAY_BET, wager);
+    }
+
+    bool action(int seat, int handIndex, const DecisionSet& decisions, int& choice) {
+        (void)seat;
+        (void)handIndex;
+        (void)decisions;
+        long long value;
+        if (!next(REPLAY_ACTION, value)) return false;
+        choice = static_cast<int>(value);
+        return true;
+    }
+
+    bool playAgain() {
+        if (diverged || pos == end) return false;
+        if (*pos == REPLAY_QUIT) {
+            pos++;
+            return false;
+        }
+        long long value;
+        return next(REPLAY_PLAY_AGAIN, value);
+    }
+
+    void roundSettled(long long balance) {
+        rounds++;
+        long long recorded;
+        if (pos == end) {
+            diverge("round " + to_string(rounds) + " was not finished in the recording");
+        } else if (next(REPLAY_SETTLED, recorded) && recorded != balance) {
+            diverge("round " + to_string(rounds) + " left a balance of " + to_string(balance) +
+                    " cents, recorded " + to_string(recorded));
+        }
+    }
+
+    // Answers nobody asked for are a divergence too
+    void finish() {
+        if (!diverged && pos != end) {
+            diverge("the session ended after round " + to_string(rounds) + " with answers left over");
+        }
+    }
+
+    long long getRounds() const { return rounds; }
+    bool hasDiverged() const { return diverged; }
+    const std::string& getMessage() const { return message; }
+
+private:
+    const unsigned char* pos;
+    const unsigned char* end;
+    long long rounds;
+    bool diverged;
+    std::string message;
+
+    void diverge(const std::string& what) {
+        if (diverged) return;
+        diverged = true;
+        message = what;
+    }
+
+    bool next(ReplayEvent expected, long long& value) {
+        if (diverged || pos == end) return false;
+        if (*pos != expected) {
+            diverge("in round " + to_string(rounds + 1) + " the game asked for " + EVENT_NAMES[expected] +
+                    ", recorded " + EVENT_NAMES[*pos]);
+            return false;
+        }
+        pos++;
+        value = 0;
+        return !hasValue(expected) || readVarint(pos, end, value);
+    }
+};
+
+template <class Rules>
+static ReplayResult replayWith(const RecordedSession& session) {
+    BasicBlackjackGame<Rules> game(true);
+    game.setHistoryLimit(0);
+    game.setSeed(session.seed);
+    ReplayInput input(session.events);
+    game.playSession(input);
+    input.finish();
+
+    ReplayResult result;
+    result.rounds = input.getRounds();
+    result.hands = game.getStatistics().getTotalGames();
+    result.diverged = input.hasDiverged();
+    result.message = input.getMessage();
+    return result;
+}
+
+ReplayResult replaySession(const RecordedSession& session) {
+    if (session.rules == StandardRules::ruleSet()) {
+        return replayWith<StandardRules>(session);
+    }
+    return replayWith<RuntimeRules>(session);
+}
+
+/* Sessions under the same rules run together, handed out one at a time
+   from an atomic counter; RuntimeRules is switched between groups, while
+   no worker is running. */
+int replayRecordings(const std::vector<std::string>& paths, int threads, std::ostream& out) {
+    std::vector<RecordedSession> sessions;
+    for (size_t f = 0; f < paths.size(); f++) {
+        if (!readRecording(paths[f], sessions)) {
+            out << "Not a session recording: " << paths[f] << endl;
+            return -1;
+        }
+    }
+    if (threads < 1) threads = 1;
+
+    std::vector<ReplayResult> results(sessions.size());
+    std::vector<bool> done(sessions.size(), false);
+    RuleSet savedRules = RuntimeRules::current;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (size_t first = 0; first < sessions.size(); first++) {
+        if (done[first]) continue;
+        RuleSet rules = sessions[first].rules;
+        std::vector<size_t> group;
+        for (size_t s = first; s < sessions.size(); s++) {
+            if (!done[s] && sessions[s].rules == rules) {
+                group.push_back(s);
+                done[s] = true;
+            }
+        }
+        RuntimeRules::current = rules;
+
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        int count = (group.size() < static_cast<size_t>(threads)) ? static_cast<int>(group.size()) : threads;
+        for (int t = 0; t < count; t++) {
+            workers.push_back(std::thread([&]() {
+                size_t g;
+                while ((g = next.fetch_add(1)) < group.size()) {
+                    results[group[g]] = replaySession(sessions[group[g]]);
+                }
+            }));
+        }
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    RuntimeRules::current = savedRules;
+
+    long long rounds = 0, hands = 0;
+    int diverged = 0;
+    for (size_t s = 0; s < sessions.size(); s++) {
+        rounds += results[s].rounds;
+        hands += results[s].hands;
+        if (results[s].diverged) {
+            diverged++;
+            out << sessions[s].source << ": session " << sessions[s].index << " (seed " << sessions[s].seed
+                << ") diverged: " << results[s].message << endl;
+        }
+    }
+    out << "Replayed " << sessions.size() << " sessions, " << rounds << " rounds, " << hands << " hands in "
+        << fixed << setprecision(3) << elapsed.count() << " s (" << setprecision(0)
+        << (elapsed.count() > 0 ? hands / elapsed.count() : 0) << " hands/sec); "
+        << diverged << " diverged" << endl;
+    return diverged;
+}
@@ -0,0 +1,43 @@
+#include "Blackjack.h"
+
+using namespace std;
+
+// SettlementBatch implementation
+// Clearing keeps the capacity, so a batch reused every round never allocates
+void SettlementBatch::clear() {
+    playerTotal.clear();
+    houseTotal.clear();
+    flags.clear();
+    wager.clear();
+}
+
+void SettlementBatch::add(int player, int house, unsigned char handFlags, long long handWager) {
+    playerTotal.push_back(static_cast<unsigned char>(player));
+    houseTotal.push_back(static_cast<unsigned char>(house));
+    flags.push_back(handFlags);
+    wager.push_back(handWager);
+}
+
+/* Each input and output is its own contiguous array and every hand goes
+   through the same arithmetic, so the loop has no data-dependent branches
+   and the compiler is free to vectorize it. */
+template <class Rules>
+void settleBatch(SettlementBatch& batch) {
+    size_t n = batch.size();
+    batch.payout.resize(n);
+    batch.outcome.resize(n);
+    const unsigned char* playerTotal = batch.playerTotal.data();
+    const unsigned char* houseTotal = batch.houseTotal.data();
+    const unsigned char* flags = batch.flags.data();
+    const long long* wager = batch.wager.data();
+    long long* payout = batch.payout.data();
+    signed char* outcome = batch.outcome.data();
+    for (size_t i = 0; i < n; i++) {
+        int result;
+        payout[i] = settleHand<Rules>(playerTotal[i], houseTotal[i], flags[i], wager[i], result);
+        outcome[i] = static_cast<signed char>(result);
+    }
+}
+
+template void settleBatch<StandardRules>(SettlementBatch& batch);
+template void settleBatch<RuntimeRules>(SettlementBatch& batch);
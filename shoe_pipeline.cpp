@@ -0,0 +1,54 @@
+#include "ShoePipeline.h"
+
+using namespace std;
+
+// ShoePipeline implementation
+ShoePipeline::ShoePipeline(int workers)
+    : workers(workers), jobs(static_cast<size_t>(workers) * JOBS_PER_WORKER), ready(workers), spare(workers) {
+    for (int w = 0; w < workers; w++) {
+        for (int j = 0; j < JOBS_PER_WORKER; j++) {
+            spare[w].tryPush(&jobs[static_cast<size_t>(w) * JOBS_PER_WORKER + j]);
+        }
+    }
+}
+
+// Jobs go to whichever worker next has a free buffer
+template <class Rules>
+void ShoePipeline::produce(long long first, long long last, Xoshiro256& stream) {
+    int w = 0;
+    for (long long chunk = first; chunk < last; chunk++) {
+        Job* job;
+        while (!spare[w].tryPop(job)) {
+            w = (w + 1) % workers;
+            if (w == 0) std::this_thread::yield();
+        }
+        job->chunk = chunk;
+        Xoshiro256 rng = stream;
+        for (int s = 0; s < SHOES_PER_JOB; s++) {
+            BasicCardDeck<Rules>::fillShoe(job->shoes[s].cards, rng);
+            job->shoes[s].streamAfter = rng;
+        }
+        ready[w].tryPush(job);
+        stream.jump();
+        w = (w + 1) % workers;
+    }
+    // A worker holds at most all of its own jobs, so the marker always fits
+    for (int t = 0; t < workers; t++) {
+        ready[t].tryPush(nullptr);
+    }
+}
+
+template void ShoePipeline::produce<StandardRules>(long long first, long long last, Xoshiro256& stream);
+template void ShoePipeline::produce<RuntimeRules>(long long first, long long last, Xoshiro256& stream);
+
+ShoePipeline::Job* ShoePipeline::next(int worker) {
+    Job* job;
+    while (!ready[worker].tryPop(job)) {
+        std::this_thread::yield();
+    }
+    return job;
+}
+
+void ShoePipeline::release(int worker, Job* job) {
+    spare[worker].tryPush(job);
+}
@@ -0,0 +1,352 @@
+#include "Blackjack.h"
+#include "EVEngine.h"
+#include "LogWriter.h"
+#include "ShoePipeline.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Strategies
+
+// Flat betting: always the table minimum
+long long BasicStrategy::chooseBet(long long balance) {
+    (void)balance;
+    return BlackjackGame::MIN_BET;
+}
+
+ActionType BasicStrategy::chooseAction(const Player& player, int handIndex, int houseUpcard,
+                                       bool canSplit, bool canDouble) {
+    return DecisionTable::recommendedAction(player.getHand(handIndex), houseUpcard, canSplit, canDouble);
+}
+
+long long DealerStrategy::chooseBet(long long balance) {
+    (void)balance;
+    return BlackjackGame::MIN_BET;
+}
+
+ActionType DealerStrategy::chooseAction(const Player& player, int handIndex, int houseUpcard,
+                                        bool canSplit, bool canDouble) {
+    (void)houseUpcard;
+    (void)canSplit;
+    (void)canDouble;
+    return rules.houseHits(player.getScore(handIndex), player.isSoft(handIndex)) ? ACTION_HIT : ACTION_STAND;
+}
+
+CountingStrategy::CountingStrategy(const CountingSystem& system, int maxUnits)
+    : system(system), maxUnits(maxUnits), trueCount(0.0) {}
+
+// One unit up to a true count of +1, then two more units per point
+long long CountingStrategy::chooseBet(long long balance) {
+    (void)balance;
+    int units = 1;
+    if (trueCount >= 2.0) {
+        units = 2 * (static_cast<int>(trueCount) - 1);
+    }
+    if (units > maxUnits) units = maxUnits;
+    return BlackjackGame::MIN_BET * units;
+}
+
+ActionType CountingStrategy::chooseAction(const Player& player, int handIndex, int houseUpcard,
+                                          bool canSplit, bool canDouble) {
+    return DecisionTable::recommendedAction(player.getHand(handIndex), houseUpcard, canSplit, canDouble);
+}
+
+void CountingStrategy::observeShoe(const ShoeCounts& deck, int holeCard) {
+    (void)holeCard;
+    trueCount = deck.getTrueCount();
+}
+
+Strategy* createStrategy(const std::string& name, const RuleSet& rules) {
+    if (name == "basic") return new BasicStrategy();
+    if (name == "dealer") return new DealerStrategy(rules);
+    if (name == "ev") return new EVStrategy();
+
+    size_t colon = name.find(':');
+    const CountingSystem* system = findCountingSystem(name.substr(0, colon));
+    if (system) {
+        int maxUnits = (colon == std::string::npos) ? 8 : atoi(name.c_str() + colon + 1);
+        return new CountingStrategy(*system, maxUnits < 1 ? 1 : maxUnits);
+    }
+    return nullptr;
+}
+
+// Headless simulation
+
+// One complete round for a single seat, decided by the strategy
+template <class Rules>
+void BasicBlackjackGame<Rules>::playAutomatedRound(Strategy& strategy) {
+    PROFILE_COUNT(PROFILE_ROUNDS);
+    Player player;
+    Player house;
+    long long handBet[1][2];
+
+    strategy.observeShoe(deck, 0);
+    long long initialBet = strategy.chooseBet(balance);
+    handBet[0][0] = initialBet;
+    handBet[0][1] = 0;
+    balance -= initialBet;
+    totalWagered += initialBet;
+
+    player.addCard(deck.drawCard());
+    player.addCard(deck.drawCard());
+    int houseUpcard = deck.drawCard();
+    int holeCard = deck.drawCard();
+    house.addCard(houseUpcard);
+    house.addCard(holeCard);
+
+    for (int h = 0; h < player.getNumberOfHands(); h++) {
+        bool turnOver = false;
+        while (!turnOver && player.getScore(h) < 21) {
+            bool canSplit, canDouble;
+            ActionType action;
+            {
+                PROFILE_SCOPE(PROFILE_DECISION);
+                canSplit = splitAllowed(player, h);
+                canDouble = doubleAllowed(player, h);
+                strategy.observeShoe(deck, holeCard);
+                action = strategy.chooseAction(player, h, houseUpcard, canSplit, canDouble);
+            }
+
+            if (action == ACTION_HIT) {
+                player.addCard(deck.drawCard(), h);
+            } else if (action == ACTION_DOUBLE && canDouble) {
+                balance -= handBet[0][h];
+                totalWagered += handBet[0][h];
+                handBet[0][h] *= 2;
+                player.setDoubledDown(h, true);
+                PROFILE_COUNT(PROFILE_DOUBLES);
+                player.addCard(deck.drawCard(), h);
+                turnOver = true;
+            } else if (action == ACTION_SPLIT && canSplit) {
+                // Each half gets its own bet and a second card
+                player.splitHand();
+                PROFILE_COUNT(PROFILE_SPLITS);
+                handBet[0][1] = handBet[0][0];
+                balance -= handBet[0][1];
+                totalWagered += handBet[0][1];
+                player.addCard(deck.drawCard(), 0);
+                player.addCard(deck.drawCard(), 1);
+            } else {
+                turnOver = true;
+            }
+        }
+    }
+
+    {
+        PROFILE_SCOPE(PROFILE_HOUSE);
+        while (houseHits(house)) {
+            house.addCard(deck.drawCard(), 0);
+        }
+    }
+
+    long long net = settleRound(&player, handBet, 1, house);
+    stats.recordRound(static_cast<double>(net), static_cast<double>(initialBet));
+}
+
+// Run a batch of rounds with no console I/O and report the throughput
+template <class Rules>
+void BasicBlackjackGame<Rules>::simulate(long long rounds, Strategy& strategy) {
+    if (strategy.countingSystem()) {
+        deck.setCountingSystem(*strategy.countingSystem());
+    }
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (long long r = 0; r < rounds; r++) {
+        playAutomatedRound(strategy);
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    reportSimulation(rounds, strategy.name(), elapsed.count());
+}
+
+// Play a chunk of rounds starting from a fresh shoe on the given stream
+template <class Rules>
+void BasicBlackjackGame<Rules>::simulateShoe(const Xoshiro256& stream, long long rounds, Strategy& strategy) {
+    if (strategy.countingSystem()) {
+        deck.setCountingSystem(*strategy.countingSystem());
+    }
+    deck.reseed(stream);
+    for (long long r = 0; r < rounds; r++) {
+        playAutomatedRound(strategy);
+    }
+}
+
+// The same, opening with shoes shuffled ahead of time by the shoe pipeline
+template <class Rules>
+void BasicBlackjackGame<Rules>::simulateShoe(const PreparedShoe* shoes, int count, long long rounds,
+                                             Strategy& strategy) {
+    if (strategy.countingSystem()) {
+        deck.setCountingSystem(*strategy.countingSystem());
+    }
+    deck.usePreparedShoes(shoes, count);
+    deck.reshuffle();
+    for (long long r = 0; r < rounds; r++) {
+        playAutomatedRound(strategy);
+    }
+    deck.usePreparedShoes(nullptr, 0);
+}
+
+// Add another game's results to this one (used to combine workers)
+template <class Rules>
+void BasicBlackjackGame<Rules>::mergeResults(const BasicBlackjackGame& other) {
+    stats.merge(other.stats);
+    balance += other.balance - other.initialBalance;
+    totalWagered += other.totalWagered;
+    handPerformance.merge(other.handPerformance);
+}
+
+template <class Rules>
+void BasicBlackjackGame<Rules>::reportSimulation(long long rounds, const char* strategyName,
+                                                 double seconds) const {
+    long long net = balance - initialBalance;
+    cout << "Simulated " << rounds << " rounds with the '" << strategyName << "' strategy" << endl;
+    stats.displayStatistics();
+    cout << "Distinct final hands: " << handPerformance.size() << endl;
+    cout << "Total wagered: $" << fixed << setprecision(2) << totalWagered / 100.0 << endl;
+    cout << "Net result: $" << net / 100.0 << endl;
+    if (totalWagered > 0) {
+        cout << "House edge: " << setprecision(3) << (-static_cast<double>(net) / totalWagered * 100) << "%" << endl;
+    }
+    cout << "Elapsed: " << setprecision(3) << seconds << " s ("
+         << setprecision(0) << (seconds > 0 ? rounds / seconds : 0) << " rounds/sec)" << endl;
+}
+
+// Parallel driver
+
+// Rounds one seat gets out of a shoe before the cut card (about 5.7 cards a round)
+static const long long ROUNDS_PER_SHOE = 48;
+// Chunks per batch (about 200,000 rounds); statistics are combined at batch
+// ends, and the size does not depend on the thread count
+static const long long BATCH_CHUNKS = 4096;
+
+/* Work is handed out one shoe-sized chunk at a time from an atomic counter.
+   Chunk i always plays on the stream for seed jumped ahead i times (2^128
+   draws apart, so no two chunks can overlap), so the totals do not depend
+   on which worker picked it up. The streams for a batch are laid out by
+   the driver before the workers start. Every worker writes only to its
+   own game. Chunks run in batches: each chunk's statistics are set aside
+   and merged in chunk order once the batch is joined, so even the
+   floating-point estimates and the stopping point are identical for any
+   thread count. With the pipeline a producer thread shuffles each chunk's
+   opening shoes from the same streams while the workers play, so the
+   results do not change either. With a precision target the run ends after the first
+   batch whose 95% interval for the house edge is narrower than the target
+   (in percentage points). */
+template <class Rules>
+static void runParallel(long long rounds, const std::string& strategyName, int threads, std::uint64_t seed,
+                        LogWriter* log, size_t historyLimit, double precision, bool pipeline) {
+    typedef BasicBlackjackGame<Rules> Game;
+    long long chunks = (rounds + ROUNDS_PER_SHOE - 1) / ROUNDS_PER_SHOE;
+    std::vector<Game*> games(threads);
+    std::vector<Strategy*> strategies(threads);
+    for (int t = 0; t < threads; t++) {
+        games[t] = new Game(true);
+        games[t]->setHistoryLimit(historyLimit);
+        if (log) {
+            games[t]->setLog(*log);
+        }
+        strategies[t] = createStrategy(strategyName, Rules::ruleSet());
+    }
+    std::vector<GameStatistics> chunkStats(static_cast<size_t>(BATCH_CHUNKS));
+    std::vector<Xoshiro256> chunkStreams(static_cast<size_t>(BATCH_CHUNKS));
+    Xoshiro256 stream(seed);
+    ShoePipeline* shoes = pipeline ? new ShoePipeline(threads) : nullptr;
+    GameStatistics totalStats;
+    long long played = 0;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (long long batchStart = 0; batchStart < chunks; batchStart += BATCH_CHUNKS) {
+        long long batchEnd = std::min(chunks, batchStart + BATCH_CHUNKS);
+        std::vector<std::thread> workers;
+        if (shoes) {
+            workers.push_back(std::thread([&]() {
+                shoes->produce<Rules>(batchStart, batchEnd, stream);
+            }));
+            for (int t = 0; t < threads; t++) {
+                workers.push_back(std::thread([&, t]() {
+                    ShoePipeline::Job* job;
+                    while ((job = shoes->next(t)) != nullptr) {
+                        long long count = std::min(ROUNDS_PER_SHOE, rounds - job->chunk * ROUNDS_PER_SHOE);
+                        games[t]->simulateShoe(job->shoes, ShoePipeline::SHOES_PER_JOB, count, *strategies[t]);
+                        chunkStats[job->chunk - batchStart] = games[t]->takeStatistics();
+                        shoes->release(t, job);
+                    }
+                }));
+            }
+        } else {
+            for (long long c = 0; c < batchEnd - batchStart; c++) {
+                chunkStreams[c] = stream;
+                stream.jump();
+            }
+            std::atomic<long long> nextChunk(batchStart);
+            for (int t = 0; t < threads; t++) {
+                workers.push_back(std::thread([&, t]() {
+                    long long chunk;
+                    while ((chunk = nextChunk.fetch_add(1, std::memory_order_relaxed)) < batchEnd) {
+                        long long count = std::min(ROUNDS_PER_SHOE, rounds - chunk * ROUNDS_PER_SHOE);
+                        games[t]->simulateShoe(chunkStreams[chunk - batchStart], count, *strategies[t]);
+                        chunkStats[chunk - batchStart] = games[t]->takeStatistics();
+                    }
+                }));
+            }
+        }
+        for (size_t t = 0; t < workers.size(); t++) {
+            workers[t].join();
+        }
+        for (long long c = 0; c < batchEnd - batchStart; c++) {
+            totalStats.merge(chunkStats[c]);
+        }
+        played = std::min(rounds, batchEnd * ROUNDS_PER_SHOE);
+
+        const RunningStat& edge = totalStats.getRoundReturn();
+        if (precision > 0 && edge.count > 1 && 2 * edge.halfWidth95() * 100 < precision) {
+            break;
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    delete shoes;
+
+    Game total(true);
+    for (int t = 0; t < threads; t++) {
+        total.mergeResults(*games[t]);
+        delete games[t];
+        delete strategies[t];
+    }
+    total.addStatistics(totalStats);
+    cout << "Seed: " << seed << ", worker threads: " << threads << (pipeline ? " plus a shoe producer" : "") << endl;
+    cout << "Rules: " << describeRules(Rules::ruleSet()) << endl;
+    if (precision > 0) {
+        double width = 2 * totalStats.getRoundReturn().halfWidth95() * 100;
+        cout << "Precision target: house-edge 95% CI narrower than " << precision << "% ("
+             << (width < precision ? "reached" : "not reached") << " after " << played << " rounds)" << endl;
+    }
+    total.reportSimulation(played, strategyName.c_str(), elapsed.count());
+}
+
+// The standard table runs fully specialized; any other rules run on the runtime-rules build
+void simulateParallel(long long rounds, const std::string& strategyName, int threads, std::uint64_t seed,
+                      LogWriter* log, size_t historyLimit, double precision, bool pipeline) {
+    if (threads < 1) threads = 1;
+    if (RuntimeRules::current == StandardRules::ruleSet()) {
+        runParallel<StandardRules>(rounds, strategyName, threads, seed, log, historyLimit, precision, pipeline);
+    } else {
+        runParallel<RuntimeRules>(rounds, strategyName, threads, seed, log, historyLimit, precision, pipeline);
+    }
+}
+
+// The game's other members are instantiated in blackjack_functions.cpp
+template void BasicBlackjackGame<StandardRules>::playAutomatedRound(Strategy&);
+template void BasicBlackjackGame<StandardRules>::simulate(long long, Strategy&);
+template void BasicBlackjackGame<StandardRules>::simulateShoe(const Xoshiro256&, long long, Strategy&);
+template void BasicBlackjackGame<StandardRules>::simulateShoe(const PreparedShoe*, int, long long, Strategy&);
+template void BasicBlackjackGame<StandardRules>::mergeResults(const BasicBlackjackGame&);
+template void BasicBlackjackGame<StandardRules>::reportSimulation(long long, const char*, double) const;
+template void BasicBlackjackGame<RuntimeRules>::playAutomatedRound(Strategy&);
+template void BasicBlackjackGame<RuntimeRules>::simulate(long long, Strategy&);
+template void BasicBlackjackGame<RuntimeRules>::simulateShoe(const Xoshiro256&, long long, Strategy&);
+template void BasicBlackjackGame<RuntimeRules>::simulateShoe(const PreparedShoe*, int, long long, Strategy&);
+template void BasicBlackjackGame<RuntimeRules>::mergeResults(const BasicBlackjackGame&);
+template void BasicBlackjackGame<RuntimeRules>::reportSimulation(long long, const char*, double) const;
@@ -0,0 +1,163 @@
+#include "Blackjack.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Strategy generator
+/* A state is the hard total (aces as 1) and whether the hand holds an ace,
+   so drawing a card only ever raises the hard total and every table can
+   be filled from 21 down. The soft total is ten more while that fits.
+   Shoe size, the house's draw and the doubles allowed follow RuntimeRules. */
+
+static const int MAX_HARD = 31;     // 21 plus the largest card
+
+static int effectiveTotal(int hard, bool ace) {
+    return (ace && hard <= 11) ? hard + 10 : hard;
+}
+
+// Values for one house upcard; card odds are fixed for the whole solve
+struct UpcardSolver {
+    double odds[11];                    // By card value 1-10
+    double house[MAX_HARD + 1][2][6];   // Final house total 17-21, then bust
+    double stand[MAX_HARD + 1][2];
+    double best[MAX_HARD + 1][2];       // Stand or hit
+    double doubleDown[MAX_HARD + 1][2];
+
+    explicit UpcardSolver(int upcard);
+    double bestWithDouble(int hard, bool ace, bool afterSplit) const;
+    double split(int value) const;
+};
+
+UpcardSolver::UpcardSolver(int upcard) {
+    // A full shoe less the upcard
+    double counts[11] = { 0 };
+    for (int rank = 1; rank <= 13; rank++) {
+        counts[rank > 10 ? 10 : rank] += 4 * RuntimeRules::decks();
+    }
+    counts[upcard]--;
+    for (int v = 1; v <= 10; v++) {
+        odds[v] = counts[v] / (RuntimeRules::shoeSize() - 1);
+    }
+
+    // The house draws to its rule from every state, highest totals first
+    for (int hard = MAX_HARD; hard >= 1; hard--) {
+        for (int a = 0; a < 2; a++) {
+            double* out = house[hard][a];
+            int total = effectiveTotal(hard, a != 0);
+            for (int i = 0; i < 6; i++) {
+                out[i] = 0.0;
+            }
+            if (!RuntimeRules::houseHits(total, a != 0 && hard <= 11)) {
+                out[total > 21 ? 5 : total - 17] = 1.0;
+                continue;
+            }
+            for (int v = 1; v <= 10; v++) {
+                const double* next = house[hard + v][(a != 0 || v == 1) ? 1 : 0];
+                for (int i = 0; i < 6; i++) {
+                    out[i] += odds[v] * next[i];
+                }
+            }
+        }
+    }
+    const double* houseFinal = house[upcard][upcard == 1 ? 1 : 0];
+
+    // Ties go to the house, so only a higher total or a house bust wins
+    for (int hard = MAX_HARD; hard >= 1; hard--) {
+        for (int a = 0; a < 2; a++) {
+            int total = effectiveTotal(hard, a != 0);
+            double win = houseFinal[5];
+            for (int t = 17; t < total && t <= 21; t++) {
+                win += houseFinal[t - 17];
+            }
+            stand[hard][a] = (total > 21) ? -1.0 : 2.0 * win - 1.0;
+        }
+    }
+
+    for (int hard = MAX_HARD; hard >= 1; hard--) {
+        for (int a = 0; a < 2; a++) {
+            if (effectiveTotal(hard, a != 0) > 21) {
+                best[hard][a] = -1.0;
+                doubleDown[hard][a] = -2.0;
+                continue;
+            }
+            double hit = 0.0;
+            double dbl = 0.0;
+            for (int v = 1; v <= 10; v++) {
+                int next = min(hard + v, MAX_HARD);
+                int nextAce = (a != 0 || v == 1) ? 1 : 0;
+                hit += odds[v] * best[next][nextAce];
+                dbl += odds[v] * stand[next][nextAce];
+            }
+            best[hard][a] = max(stand[hard][a], hit);
+            doubleDown[hard][a] = 2.0 * dbl;
+        }
+    }
+}
+
+// Two-card value: doubling is allowed where the table's rule allows it
+double UpcardSolver::bestWithDouble(int hard, bool ace, bool afterSplit) const {
+    int a = ace ? 1 : 0;
+    double value = best[hard][a];
+    if (RuntimeRules::canDouble(effectiveTotal(hard, ace), ace && hard <= 11, afterSplit)) {
+        value = max(value, doubleDown[hard][a]);
+    }
+    return value;
+}
+
+// Each half draws a second card and may double if the rules allow, but not split again
+double UpcardSolver::split(int value) const {
+    double ev = 0.0;
+    for (int v = 1; v <= 10; v++) {
+        ev += odds[v] * bestWithDouble(value + v, value == 1 || v == 1, true);
+    }
+    return 2.0 * ev;
+}
+
+// Grid cell for a state, following the same fallbacks as the basic strategy grids
+static StrategyCell cellFor(const UpcardSolver& solver, int hard, bool ace) {
+    int a = ace ? 1 : 0;
+    bool standBetter = solver.stand[hard][a] >= solver.best[hard][a];
+    if (RuntimeRules::canDouble(effectiveTotal(hard, ace), ace && hard <= 11, false) &&
+        solver.doubleDown[hard][a] > solver.best[hard][a]) {
+        return standBetter ? CELL_DS : CELL_DH;
+    }
+    return standBetter ? CELL_S : CELL_H;
+}
+
+StrategyGrid generateStrategyGrid(int threads) {
+    StrategyGrid grid = DecisionTable::grid();
+    if (threads < 1) threads = 1;
+    if (threads > StrategyGrid::UPCARDS) threads = StrategyGrid::UPCARDS;
+
+    // Columns are independent, so workers take whole upcards
+    std::atomic<int> nextColumn(0);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.push_back(std::thread([&]() {
+            int column;
+            while ((column = nextColumn.fetch_add(1)) < StrategyGrid::UPCARDS) {
+                int upcard = (column == 9) ? 1 : column + 2;
+                UpcardSolver solver(upcard);
+                for (int total = 4; total <= 21; total++) {
+                    grid.hard[total][column] = cellFor(solver, total, false);
+                }
+                for (int total = 12; total <= 21; total++) {
+                    grid.soft[total][column] = cellFor(solver, total - 10, true);
+                }
+                for (int value = 2; value <= 11; value++) {
+                    int card = (value == 11) ? 1 : value;
+                    bool split = RuntimeRules::canSplit() &&
+                                 solver.split(card) > solver.bestWithDouble(2 * card, card == 1, false);
+                    grid.pairs[value][column] = split ? CELL_P : CELL_H;
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+    return grid;
+}
@@ -0,0 +1,207 @@
+#include "Blackjack.h"
+#include <sstream>
+
+using namespace std;
+
+// Basic strategy grids
+
+// Short names keep the grids readable
+static constexpr StrategyCell S = CELL_S;
+static constexpr StrategyCell H = CELL_H;
+static constexpr StrategyCell Dh = CELL_DH;
+static constexpr StrategyCell Ds = CELL_DS;
+static constexpr StrategyCell P = CELL_P;
+
+// Columns: house upcard 2, 3, 4, 5, 6, 7, 8, 9, 10, A
+static const int UPCARDS = StrategyGrid::UPCARDS;
+
+// Hard totals, rows 0-21 (rows below 4 are never reached)
+static constexpr StrategyCell hardTable[22][UPCARDS] = {
+    { H, H, H, H, H, H, H, H, H, H },   // 0
+    { H, H, H, H, H, H, H, H, H, H },   // 1
+    { H, H, H, H, H, H, H, H, H, H },   // 2
+    { H, H, H, H, H, H, H, H, H, H },   // 3
+    { H, H, H, H, H, H, H, H, H, H },   // 4
+    { H, H, H, H, H, H, H, H, H, H },   // 5
+    { H, H, H, H, H, H, H, H, H, H },   // 6
+    { H, H, H, H, H, H, H, H, H, H },   // 7
+    { H, H, H, H, H, H, H, H, H, H },   // 8
+    { H, Dh, Dh, Dh, Dh, H, H, H, H, H },   // 9
+    { Dh, Dh, Dh, Dh, Dh, Dh, Dh, Dh, H, H },   // 10
+    { Dh, Dh, Dh, Dh, Dh, Dh, Dh, Dh, Dh, H },  // 11
+    { H, H, S, S, S, H, H, H, H, H },   // 12
+    { S, S, S, S, S, H, H, H, H, H },   // 13
+    { S, S, S, S, S, H, H, H, H, H },   // 14
+    { S, S, S, S, S, H, H, H, H, H },   // 15
+    { S, S, S, S, S, H, H, H, H, H },   // 16
+    { S, S, S, S, S, S, S, S, S, S },   // 17
+    { S, S, S, S, S, S, S, S, S, S },   // 18
+    { S, S, S, S, S, S, S, S, S, S },   // 19
+    { S, S, S, S, S, S, S, S, S, S },   // 20
+    { S, S, S, S, S, S, S, S, S, S }    // 21
+};
+
+// Soft totals, rows 0-21 (only 12-21 are reachable)
+static constexpr StrategyCell softTable[22][UPCARDS] = {
+    { H, H, H, H, H, H, H, H, H, H },   // 0
+    { H, H, H, H, H, H, H, H, H, H },   // 1
+    { H, H, H, H, H, H, H, H, H, H },   // 2
+    { H, H, H, H, H, H, H, H, H, H },   // 3
+    { H, H, H, H, H, H, H, H, H, H },   // 4
+    { H, H, H, H, H, H, H, H, H, H },   // 5
+    { H, H, H, H, H, H, H, H, H, H },   // 6
+    { H, H, H, H, H, H, H, H, H, H },   // 7
+    { H, H, H, H, H, H, H, H, H, H },   // 8
+    { H, H, H, H, H, H, H, H, H, H },   // 9
+    { H, H, H, H, H, H, H, H, H, H },   // 10
+    { H, H, H, H, H, H, H, H, H, H },   // 11
+    { H, H, H, H, H, H, H, H, H, H },   // 12 (A,A)
+    { H, H, H, H, H, H, H, H, H, H },   // 13
+    { H, H, H, H, H, H, H, H, H, H },   // 14
+    { H, H, H, H, H, H, H, H, H, H },   // 15
+    { H, H, Dh, Dh, Dh, H, H, H, H, H },    // 16
+    { H, Dh, Dh, Dh, Dh, H, H, H, H, H },   // 17
+    { S, Ds, Ds, Ds, Ds, S, S, H, H, H },   // 18
+    { S, S, S, S, S, S, S, S, S, S },   // 19
+    { S, S, S, S, S, S, S, S, S, S },   // 20
+    { S, S, S, S, S, S, S, S, S, S }    // 21
+};
+
+// Pairs by card value 0-11 (2-11 used, 11 = aces); H means "play the total"
+static constexpr StrategyCell pairTable[12][UPCARDS] = {
+    { H, H, H, H, H, H, H, H, H, H },   // 0
+    { H, H, H, H, H, H, H, H, H, H },   // 1
+    { P, P, P, P, P, P, H, H, H, H },   // 2,2
+    { P, P, P, P, P, P, H, H, H, H },   // 3,3
+    { H, H, H, H, H, H, H, H, H, H },   // 4,4
+    { H, H, H, H, H, H, H, H, H, H },   // 5,5
+    { P, P, P, P, P, H, H, H, H, H },   // 6,6
+    { P, P, P, P, P, P, H, H, H, H },   // 7,7
+    { P, P, P, P, P, P, P, P, P, P },   // 8,8
+    { P, P, P, P, P, H, P, P, H, H },   // 9,9
+    { H, H, H, H, H, H, H, H, H, H },   // 10,10
+    { P, P, P, P, P, P, P, P, P, P }    // A,A
+};
+
+// Blackjack value of a card rank (ace counted as 11)
+static inline int cardValue(int card) {
+    if (card == 1) return 11;
+    if (card > 10) return 10;
+    return card;
+}
+
+static StrategyGrid basicStrategyGrid() {
+    StrategyGrid grid;
+    memcpy(grid.hard, hardTable, sizeof(grid.hard));
+    memcpy(grid.soft, softTable, sizeof(grid.soft));
+    memcpy(grid.pairs, pairTable, sizeof(grid.pairs));
+    return grid;
+}
+
+// The grid every decision reads
+static StrategyGrid activeGrid = basicStrategyGrid();
+
+// DecisionTable implementation
+ActionType DecisionTable::recommendedAction(const Hand& hand, int houseUpcard, bool canSplit, bool canDouble) {
+    int column = cardValue(houseUpcard) - 2;
+
+    if (canSplit && activeGrid.pairs[cardValue(hand.getCard(0))][column] == CELL_P) {
+        return ACTION_SPLIT;
+    }
+
+    int total = hand.getTotal();
+    if (total > 21) return ACTION_STAND;
+    StrategyCell cell = hand.isSoft() ? activeGrid.soft[total][column] : activeGrid.hard[total][column];
+    switch (cell) {
+        case CELL_S:
+            return ACTION_STAND;
+        case CELL_DH:
+            return canDouble ? ACTION_DOUBLE : ACTION_HIT;
+        case CELL_DS:
+            return canDouble ? ACTION_DOUBLE : ACTION_STAND;
+        default:
+            return ACTION_HIT;
+    }
+}
+
+DecisionSet DecisionTable::playerDecisions(const Hand& hand, int houseUpcard, bool canSplit, bool canDouble) {
+    DecisionSet set;
+    set.count = 0;
+    set.actions[set.count++] = ACTION_HIT;
+    set.actions[set.count++] = ACTION_STAND;
+    if (canDouble) set.actions[set.count++] = ACTION_DOUBLE;
+    if (canSplit) set.actions[set.count++] = ACTION_SPLIT;
+    set.recommended = recommendedAction(hand, houseUpcard, canSplit, canDouble);
+    return set;
+}
+
+const StrategyGrid& DecisionTable::grid() {
+    return activeGrid;
+}
+
+void DecisionTable::setGrid(const StrategyGrid& grid) {
+    activeGrid = grid;
+}
+
+// Table files
+
+static const char* const CELL_NAMES[] = { "S", "H", "Dh", "Ds", "P" };
+
+static void writeRow(ofstream& out, const char* kind, const string& label, const StrategyCell row[UPCARDS]) {
+    out << kind << ' ' << label << ':';
+    for (int c = 0; c < UPCARDS; c++) {
+        out << ' ' << CELL_NAMES[row[c]];
+    }
+    out << '\n';
+}
+
+bool DecisionTable::saveGrid(const std::string& path, const StrategyGrid& grid, const std::string& comment) {
+    ofstream out(path.c_str());
+    if (!out) return false;
+    out << "# " << comment << '\n'
+        << "# Cells: S stand, H hit, Dh double else hit, Ds double else stand, P split\n"
+        << "# Columns: house upcard 2 3 4 5 6 7 8 9 10 A\n";
+    for (int total = 4; total <= 21; total++) {
+        writeRow(out, "hard", to_string(total), grid.hard[total]);
+    }
+    for (int total = 12; total <= 21; total++) {
+        writeRow(out, "soft", to_string(total), grid.soft[total]);
+    }
+    for (int value = 2; value <= 11; value++) {
+        writeRow(out, "pair", value == 11 ? "A" : to_string(value), grid.pairs[value]);
+    }
+    return static_cast<bool>(out);
+}
+
+// The whole file is read into a copy, so a bad file leaves the grid alone
+bool DecisionTable::loadGrid(const std::string& path) {
+    ifstream in(path.c_str());
+    if (!in) return false;
+    StrategyGrid grid = activeGrid;
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream fields(line);
+        string kind, label;
+        if (!(fields >> kind >> label) || label.empty() || label[label.size() - 1] != ':') return false;
+        label.erase(label.size() - 1);
+        int index = (label == "A") ? 11 : atoi(label.c_str());
+
+        StrategyCell* row;
+        if (kind == "hard" && index >= 4 && index <= 21) row = grid.hard[index];
+        else if (kind == "soft" && index >= 12 && index <= 21) row = grid.soft[index];
+        else if (kind == "pair" && index >= 2 && index <= 11) row = grid.pairs[index];
+        else return false;
+
+        for (int c = 0; c < UPCARDS; c++) {
+            string name;
+            if (!(fields >> name)) return false;
+            int cell = 0;
+            while (cell <= CELL_P && name != CELL_NAMES[cell]) cell++;
+            if (cell > CELL_P) return false;
+            row[c] = static_cast<StrategyCell>(cell);
+        }
+    }
+    activeGrid = grid;
+    return true;
+}
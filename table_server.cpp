@@ -0,0 +1,608 @@
+#include "TableServer.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+bool parseServerAddress(const std::string& text, ServerAddress& address) {
+    address.unixSocket = false;
+    address.path.clear();
+    address.host = "127.0.0.1";
+    address.port = 0;
+    if (text.compare(0, 5, "unix:") == 0) {
+        address.unixSocket = true;
+        address.path = text.substr(5);
+        return !address.path.empty();
+    }
+    size_t colon = text.rfind(':');
+    std::string port = text;
+    if (colon != std::string::npos) {
+        address.host = text.substr(0, colon);
+        port = text.substr(colon + 1);
+    }
+    char* end;
+    long value = strtol(port.c_str(), &end, 10);
+    if (port.empty() || *end != '\0' || value < 1 || value > 65535 || address.host.empty()) return false;
+    address.port = static_cast<int>(value);
+    return true;
+}
+
+#ifdef __linux__
+
+#include <arpa/inet.h>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int signal) {
+    (void)signal;
+    stopRequested = 1;
+}
+
+// Without SA_RESTART, so a signal also wakes epoll_wait
+static void catchStopSignals() {
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestStop;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+static std::string describeAddress(const ServerAddress& address) {
+    return address.unixSocket ? "unix:" + address.path : address.host + ":" + to_string(address.port);
+}
+
+// The socket address; its length, or 0 if it cannot be used
+static socklen_t socketAddress(const ServerAddress& address, sockaddr_storage& storage) {
+    memset(&storage, 0, sizeof(storage));
+    if (address.unixSocket) {
+        sockaddr_un* local = reinterpret_cast<sockaddr_un*>(&storage);
+        if (address.path.size() >= sizeof(local->sun_path)) return 0;
+        local->sun_family = AF_UNIX;
+        memcpy(local->sun_path, address.path.c_str(), address.path.size() + 1);
+        return sizeof(sockaddr_un);
+    }
+    sockaddr_in* inet = reinterpret_cast<sockaddr_in*>(&storage);
+    inet->sin_family = AF_INET;
+    inet->sin_port = htons(static_cast<std::uint16_t>(address.port));
+    if (inet_pton(AF_INET, address.host.c_str(), &inet->sin_addr) != 1) return 0;
+    return sizeof(sockaddr_in);
+}
+
+// Answers are a line or two, so they go out at once
+static void sendImmediately(int fd, const ServerAddress& address) {
+    if (address.unixSocket) return;
+    int on = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+// Sends what it can without blocking; false if the peer is gone
+static bool sendPending(int fd, const std::string& out, size_t& sent) {
+    while (sent < out.size()) {
+        ssize_t n = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Appends what can be read without blocking; false once the peer has closed
+static bool receiveAvailable(int fd, std::string& in) {
+    char buffer[16384];
+    for (;;) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            in.append(buffer, static_cast<size_t>(n));
+            if (static_cast<size_t>(n) < sizeof(buffer)) return true;
+        } else if (n == 0) {
+            return false;
+        } else if (errno != EINTR) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+static const char ACTION_LETTERS[] = "shdp";    // By ActionType
+
+// Tables
+template <class Rules>
+class TableServer {
+public:
+    explicit TableServer(const ServerOptions& options)
+        : options(options), epollFd(-1), listenFd(-1), tablesOpened(0), peakTables(0), answers(0), rounds(0) {}
+    int run();
+
+private:
+    static const size_t MAX_BACKLOG = 1 << 20;     // Unsent output before input waits
+    static const size_t MAX_LINE = 1 << 16;
+
+    struct Table {
+        int fd;
+        size_t slot;                // In tables
+        BasicBlackjackGame<Rules> game;
+        std::string input;          // Received, not yet answered
+        std::string output;         // Not yet sent
+        size_t sent;
+        bool closing;               // Close once the output is sent
+        unsigned events;            // Registered with epoll
+
+        Table(int fd, bool compact) : fd(fd), slot(0), game(compact), sent(0), closing(false), events(0) {}
+    };
+
+    const ServerOptions& options;
+    int epollFd;
+    int listenFd;
+    std::vector<Table*> tables;
+    long long tablesOpened;
+    size_t peakTables;
+    long long answers;
+    long long rounds;
+
+    bool listen();
+    void acceptTables();
+    void answerInput(Table* table);
+    void appendQuestion(Table* table);
+    void service(Table* table);
+    void closeTable(Table* table);
+};
+
+template <class Rules>
+bool TableServer<Rules>::listen() {
+    sockaddr_storage storage;
+    socklen_t length = socketAddress(options.address, storage);
+    if (length == 0) return false;
+    listenFd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) return false;
+    if (options.address.unixSocket) {
+        unlink(options.address.path.c_str());
+    } else {
+        int on = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&storage), length) != 0 || ::listen(listenFd, SOMAXCONN) != 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+// A new table for every waiting client, asked for its seat count straight away
+template <class Rules>
+void TableServer<Rules>::acceptTables() {
+    for (;;) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE) {
+                cerr << "Out of file descriptors at " << tables.size() << " tables" << endl;
+            }
+            return;
+        }
+        sendImmediately(fd, options.address);
+
+        Table* table = new Table(fd, options.compact);
+        table->slot = tables.size();
+        tables.push_back(table);
+        if (tables.size() > peakTables) peakTables = tables.size();
+        table->game.setHistoryLimit(options.historyLimit);
+        table->game.setSeed(options.seed + static_cast<std::uint64_t>(tablesOpened++));
+        if (!options.compact) table->game.setOutput(&table->output);
+        table->game.startSession();
+        appendQuestion(table);
+        table->game.flushOutput();
+
+        epoll_event event;
+        event.events = EPOLLIN;
+        event.data.ptr = table;
+        table->events = EPOLLIN;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+        service(table);
+    }
+}
+
+template <class Rules>
+void TableServer<Rules>::appendQuestion(Table* table) {
+    if (!options.compact) return;
+    const BasicBlackjackGame<Rules>& game = table->game;
+    char line[96];
+    int length = 0;
+    double dollars = game.getBalance() / 100.0;
+    switch (game.getTableState()) {
+        case TABLE_SEATS:
+            length = snprintf(line, sizeof(line), "seats\n");
+            break;
+        case TABLE_BET:
+            length = snprintf(line, sizeof(line), "bet %d %.2f\n", game.getPendingSeat() + 1, dollars);
+            break;
+        case TABLE_ACTION: {
+            const DecisionSet& decisions = game.getPendingDecisions();
+            char offered[5];
+            for (int c = 0; c < decisions.count; c++) {
+                offered[c] = ACTION_LETTERS[decisions.actions[c]];
+            }
+            offered[decisions.count] = '\0';
+            length = snprintf(line, sizeof(line), "action %d %d %s %c\n", game.getPendingSeat() + 1,
+                              game.getPendingHand() + 1, offered, ACTION_LETTERS[decisions.recommended]);
+            break;
+        }
+        case TABLE_PLAY_AGAIN:
+            length = snprintf(line, sizeof(line), "again %.2f\n", dollars);
+            break;
+        case TABLE_OVER:
+            length = snprintf(line, sizeof(line), "over %.2f\n", dollars);
+            break;
+    }
+    table->output.append(line, static_cast<size_t>(length));
+}
+
+/* Answers every whole line received, word by word, until the table is
+   over or has a backlog of output; what is left waits for the client to
+   read. */
+template <class Rules>
+void TableServer<Rules>::answerInput(Table* table) {
+    std::string& input = table->input;
+    size_t end = input.rfind('\n');
+    if (end == std::string::npos) {
+        if (input.size() > MAX_LINE) table->closing = true;
+        return;
+    }
+    size_t pos = 0;
+    std::string word;
+    while (pos < end && !table->closing && table->output.size() - table->sent < MAX_BACKLOG) {
+        while (pos < end && isspace(static_cast<unsigned char>(input[pos]))) pos++;
+        size_t start = pos;
+        while (pos < end && !isspace(static_cast<unsigned char>(input[pos]))) pos++;
+        if (pos == start) break;
+
+        BasicBlackjackGame<Rules>& game = table->game;
+        word.assign(input, start, pos - start);
+        game.answer(TokenInput::parseAnswer(word, game.getTableState(), &game.getPendingDecisions()));
+        answers++;
+        if (game.getTableState() == TABLE_PLAY_AGAIN) rounds++;
+        if (game.getTableState() == TABLE_OVER) table->closing = true;
+        appendQuestion(table);
+        game.flushOutput();
+    }
+    input.erase(0, table->closing ? input.size() : pos);
+}
+
+// Answers and sends until the client has to catch up, then waits for the right events
+template <class Rules>
+void TableServer<Rules>::service(Table* table) {
+    for (;;) {
+        answerInput(table);
+        if (!sendPending(table->fd, table->output, table->sent)) {
+            closeTable(table);
+            return;
+        }
+        if (table->sent < table->output.size()) break;
+        table->output.clear();
+        table->sent = 0;
+        if (table->closing) {
+            closeTable(table);
+            return;
+        }
+        size_t newline = table->input.rfind('\n');
+        if (newline == std::string::npos || table->input.find_first_not_of(" \t\r\n") > newline) break;
+    }
+
+    unsigned events = table->sent < table->output.size() ? EPOLLOUT : EPOLLIN;
+    if (events != table->events) {
+        epoll_event event;
+        event.events = events;
+        event.data.ptr = table;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, table->fd, &event);
+        table->events = events;
+    }
+}
+
+template <class Rules>
+void TableServer<Rules>::closeTable(Table* table) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, table->fd, nullptr);
+    ::close(table->fd);
+    tables[table->slot] = tables.back();
+    tables[table->slot]->slot = table->slot;
+    tables.pop_back();
+    delete table;
+}
+
+template <class Rules>
+int TableServer<Rules>::run() {
+    if (!listen()) {
+        cerr << "Error: cannot listen on " << describeAddress(options.address) << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;     // The listening socket
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+    catchStopSignals();
+    cout << "Serving tables on " << describeAddress(options.address) << " ("
+         << (options.compact ? "compact" : "rendered") << " output); interrupt to stop" << endl;
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    std::vector<epoll_event> events(1024);
+    while (!stopRequested) {
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        for (int e = 0; e < count; e++) {
+            Table* table = static_cast<Table*>(events[e].data.ptr);
+            if (!table) {
+                acceptTables();
+                continue;
+            }
+            // A table closed by an earlier event in this batch is not touched
+            bool open = table->slot < tables.size() && tables[table->slot] == table;
+            if (!open) continue;
+            if (events[e].events & EPOLLIN) {
+                if (!receiveAvailable(table->fd, table->input)) {
+                    // Whatever the client sent before closing is still answered
+                    table->input += '\n';
+                    answerInput(table);
+                    if (!table->closing) {
+                        table->game.endInput();
+                        appendQuestion(table);
+                        table->game.flushOutput();
+                        table->closing = true;
+                    }
+                }
+            } else if (events[e].events & (EPOLLERR | EPOLLHUP)) {
+                closeTable(table);
+                continue;
+            }
+            service(table);
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    while (!tables.empty()) {
+        closeTable(tables.back());
+    }
+    ::close(listenFd);
+    ::close(epollFd);
+    if (options.address.unixSocket) unlink(options.address.path.c_str());
+
+    cout << "Served " << tablesOpened << " tables (" << peakTables << " at once), " << rounds << " rounds, "
+         << answers << " answers in " << fixed << setprecision(3) << elapsed.count() << " s (" << setprecision(0)
+         << (elapsed.count() > 0 ? answers / elapsed.count() : 0) << " answers/sec)" << endl;
+    return 0;
+}
+
+int runTableServer(const ServerOptions& options) {
+    if (RuntimeRules::current == StandardRules::ruleSet()) {
+        return TableServer<StandardRules>(options).run();
+    }
+    return TableServer<RuntimeRules>(options).run();
+}
+
+// Load generator
+struct LoadClient {
+    int fd;
+    bool connected;
+    std::string input;
+    std::string output;
+    size_t sent;
+    int rounds;
+    unsigned events;
+};
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const LoadOptions& options)
+        : options(options), epollFd(-1), failed(false), tablesDone(0), rounds(0), answers(0), actions(0) {}
+    int run();
+
+private:
+    const LoadOptions& options;
+    int epollFd;
+    bool failed;
+    std::vector<LoadClient> clients;
+    long long tablesDone;
+    long long rounds;
+    long long answers;
+    long long actions;
+
+    bool connectClient(LoadClient& client);
+    void disconnect(LoadClient& client);
+    bool answerQuestions(LoadClient& client);
+    void flush(LoadClient& client);
+};
+
+bool LoadGenerator::connectClient(LoadClient& client) {
+    sockaddr_storage storage;
+    socklen_t length = socketAddress(options.address, storage);
+    client.fd = socket(storage.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (length == 0 || client.fd < 0) return false;
+    sendImmediately(client.fd, options.address);
+    if (connect(client.fd, reinterpret_cast<sockaddr*>(&storage), length) != 0 && errno != EINPROGRESS) {
+        ::close(client.fd);
+        client.fd = -1;
+        return false;
+    }
+    client.connected = false;
+    client.input.clear();
+    client.output.clear();
+    client.sent = 0;
+    client.rounds = 0;
+    client.events = EPOLLIN | EPOLLOUT;
+
+    epoll_event event;
+    event.events = client.events;
+    event.data.ptr = &client;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, client.fd, &event);
+    return true;
+}
+
+void LoadGenerator::disconnect(LoadClient& client) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, client.fd, nullptr);
+    ::close(client.fd);
+    client.fd = -1;
+}
+
+static const char* const QUESTIONS[] = { "seats", "bet ", "action ", "again ", "over " };
+
+// Whether the text at pos, complete or not, can be the start of a question line
+static bool questionStart(const std::string& text, size_t pos) {
+    size_t available = text.size() - pos;
+    for (const char* question : QUESTIONS) {
+        size_t length = min(strlen(question), available);
+        if (text.compare(pos, length, question, length) == 0) return true;
+    }
+    return false;
+}
+
+// One answer per question line; false when the table is over or the reply makes no sense
+bool LoadGenerator::answerQuestions(LoadClient& client) {
+    size_t pos = 0, newline;
+    while ((newline = client.input.find('\n', pos)) != std::string::npos) {
+        const char* line = client.input.c_str() + pos;
+        pos = newline + 1;
+        if (strncmp(line, "over", 4) == 0) {
+            tablesDone++;
+            return false;
+        }
+        if (strncmp(line, "seats", 5) == 0) {
+            client.output += "1\n";
+        } else if (strncmp(line, "bet ", 4) == 0) {
+            client.output += "10\n";
+        } else if (strncmp(line, "action ", 7) == 0) {
+            client.output += "*\n";
+            actions++;
+        } else if (strncmp(line, "again ", 6) == 0) {
+            rounds++;
+            client.output += (++client.rounds < LoadOptions::ROUNDS_PER_TABLE) ? "y\n" : "n\n";
+        } else {
+            pos = line - client.input.c_str();
+            break;
+        }
+        answers++;
+    }
+    if (!questionStart(client.input, pos)) {
+        cerr << "Unexpected reply (is the server running with --quiet?): " << client.input.substr(pos, 60) << endl;
+        failed = true;
+        return false;
+    }
+    client.input.erase(0, pos);
+    return true;
+}
+
+void LoadGenerator::flush(LoadClient& client) {
+    if (!sendPending(client.fd, client.output, client.sent)) return;
+    if (client.sent == client.output.size()) {
+        client.output.clear();
+        client.sent = 0;
+    }
+    unsigned events = client.sent < client.output.size() ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    if (events != client.events) {
+        epoll_event event;
+        event.events = events;
+        event.data.ptr = &client;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, client.fd, &event);
+        client.events = events;
+    }
+}
+
+int LoadGenerator::run() {
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    clients.resize(static_cast<size_t>(options.tables));
+    for (size_t c = 0; c < clients.size(); c++) {
+        if (!connectClient(clients[c])) {
+            cerr << "Error: cannot connect to " << describeAddress(options.address) << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+    catchStopSignals();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    chrono::steady_clock::time_point stop = start + chrono::duration_cast<chrono::steady_clock::duration>(
+                                                        chrono::duration<double>(options.seconds));
+    std::vector<epoll_event> events(1024);
+    while (!failed && !stopRequested) {
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if (now >= stop) break;
+        int wait = static_cast<int>(chrono::duration_cast<chrono::milliseconds>(stop - now).count()) + 1;
+        int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), wait);
+        for (int e = 0; e < count && !failed; e++) {
+            LoadClient& client = *static_cast<LoadClient*>(events[e].data.ptr);
+            if (!client.connected) {
+                int error = 0;
+                socklen_t size = sizeof(error);
+                getsockopt(client.fd, SOL_SOCKET, SO_ERROR, &error, &size);
+                if (error != 0) {
+                    cerr << "Error: cannot connect to " << describeAddress(options.address) << ": "
+                         << strerror(error) << endl;
+                    failed = true;
+                    break;
+                }
+                client.connected = true;
+            }
+            bool open = true;
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                bool received = receiveAvailable(client.fd, client.input);
+                open = answerQuestions(client);
+                if (open && !received) {
+                    cerr << "Error: the server closed a table before it was over" << endl;
+                    failed = true;
+                }
+            }
+            if (open) {
+                flush(client);
+            } else if (!failed) {
+                // The table is over: a new one takes its place
+                disconnect(client);
+                if (!connectClient(client)) {
+                    cerr << "Error: cannot reconnect to " << describeAddress(options.address) << endl;
+                    failed = true;
+                }
+            }
+        }
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    for (size_t c = 0; c < clients.size(); c++) {
+        if (clients[c].fd >= 0) disconnect(clients[c]);
+    }
+    ::close(epollFd);
+    if (failed) return 1;
+
+    double seconds = elapsed.count() > 0 ? elapsed.count() : 1;
+    cout << "Load: " << options.tables << " tables at once for " << fixed << setprecision(3) << elapsed.count()
+         << " s, " << tablesDone << " tables played out, " << rounds << " rounds" << endl;
+    cout << setprecision(0) << answers / seconds << " answers/sec, " << actions / seconds << " actions/sec, "
+         << rounds / seconds << " rounds/sec" << endl;
+    return 0;
+}
+
+int runLoadGenerator(const LoadOptions& options) {
+    return LoadGenerator(options).run();
+}
+
+#else
+
+int runTableServer(const ServerOptions& options) {
+    (void)options;
+    cerr << "The table server needs Linux (epoll)." << endl;
+    return 1;
+}
+
+int runLoadGenerator(const LoadOptions& options) {
+    (void)options;
+    cerr << "The load generator needs Linux (epoll)." << endl;
+    return 1;
+}
+
+#endif
@@ -0,0 +1,227 @@
+/*
+ * Purpose: Regression checks for the game engine, independent of the benchmarks
+ * Usage: regression   (run through "make check"; exits non-zero on any failure)
+ */
+
+#include "Blackjack.h"
+#include "HandBatch.h"
+#include "InputSource.h"
+#include "Replay.h"
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Fixed so a failure reproduces; no check depends on what a seed deals
+static const std::uint64_t CHECK_SEED = 20241208u;
+
+static int failures = 0;
+
+static void check(const char* name, bool passed, const string& detail = "") {
+    printf("%-44s %s%s%s\n", name, passed ? "ok" : "FAILED", detail.empty() ? "" : ": ", detail.c_str());
+    if (!passed) failures++;
+}
+
+/* House hands in lockstep: two cards each, then the draw under S17 and
+   H17. The vectorized and scalar paths must agree with Hand on every hand. */
+static void checkHandBatch(bool hitSoft17) {
+    const int hands = 1 << 16;
+    const int steps = 12;
+    vector<unsigned char> cards(static_cast<size_t>(hands) * (2 + steps));
+    Xoshiro256 rng(CHECK_SEED);
+    for (size_t i = 0; i < cards.size(); i++) {
+        cards[i] = static_cast<unsigned char>(1 + rng.bounded(13));
+    }
+    HandBatch vectorBatch(hands);
+    HandBatch scalarBatch(hands);
+    scalarBatch.setVectorized(false);
+    vector<unsigned char> vectorFlags(hands);
+    vector<unsigned char> scalarFlags(hands);
+    for (int pass = 0; pass < 2; pass++) {
+        HandBatch& batch = pass == 0 ? vectorBatch : scalarBatch;
+        batch.addCards(cards.data());
+        batch.addCards(cards.data() + hands);
+        batch.playHouse(cards.data() + 2 * hands, steps, hitSoft17);
+        batch.classify(pass == 0 ? vectorFlags.data() : scalarFlags.data());
+    }
+
+    RuleSet rules = StandardRules::ruleSet();
+    rules.hitSoft17 = hitSoft17;
+    long long mismatches = 0;
+    for (int i = 0; i < hands; i++) {
+        Hand hand;
+        hand.addCard(cards[i]);
+        hand.addCard(cards[hands + i]);
+        for (int step = 0; step < steps && rules.houseHits(hand.getTotal(), hand.isSoft()); step++) {
+            hand.addCard(cards[static_cast<size_t>(2 + step) * hands + i]);
+        }
+        unsigned char flags = (hand.isSoft() ? HandBatch::HAND_SOFT : 0) |
+                              (hand.getTotal() > 21 ? HandBatch::HAND_BUST : 0) |
+                              (hand.getSize() == 2 && hand.getTotal() == 21 ? HandBatch::HAND_BLACKJACK : 0);
+        if (vectorBatch.getTotal(i) != hand.getTotal() || scalarBatch.getTotal(i) != hand.getTotal() ||
+            vectorBatch.getCardCount(i) != hand.getSize() || vectorFlags[i] != flags || scalarFlags[i] != flags) {
+            mismatches++;
+        }
+    }
+    string name = string("HandBatch (") + (vectorBatch.isVectorized() ? "AVX2" : "scalar") + ", " +
+                  (hitSoft17 ? "H17" : "S17") + ") against Hand";
+    check(name.c_str(), mismatches == 0, to_string(mismatches) + " of " + to_string(hands) + " hands differ");
+}
+
+// The runtime-rules build, set to this table's rules, plays the same rounds
+static void checkRuntimeRules() {
+    RuntimeRules::current = StandardRules::ruleSet();
+    BasicStrategy strategy;
+    BlackjackGame standard(true);
+    BasicBlackjackGame<RuntimeRules> runtime(true);
+    standard.simulateShoe(Xoshiro256(CHECK_SEED), 200000, strategy);
+    runtime.simulateShoe(Xoshiro256(CHECK_SEED), 200000, strategy);
+    check("Runtime rules against compile-time rules", runtime.getBalance() == standard.getBalance());
+}
+
+// The dealer strategy takes soft 17 from its own rules, not from the runtime-rules global
+static void checkDealerStrategy() {
+    RuleSet h17 = StandardRules::ruleSet();
+    h17.hitSoft17 = true;
+    Player soft17;
+    soft17.addCard(1);
+    soft17.addCard(6);
+    RuntimeRules::current = h17;
+    DealerStrategy standard(StandardRules::ruleSet());
+    bool standsS17 = standard.chooseAction(soft17, 0, 10, false, false) == ACTION_STAND;
+    RuntimeRules::current = StandardRules::ruleSet();
+    DealerStrategy hitting(h17);
+    bool hitsH17 = hitting.chooseAction(soft17, 0, 10, false, false) == ACTION_HIT;
+    check("Dealer strategy follows its soft-17 rule", standsS17 && hitsH17);
+}
+
+/* The interactive loop, answered in process with the recommended action,
+   and the simulator play the same rounds from the same shoe. */
+static void checkSessionsAgainstSimulator() {
+    const int sessions = 2000;
+    const int sessionRounds = 20;
+    int roundsPlayed = 0;
+    long long sessionBalance = 0;
+    CallbackInput recommended([&](const InputRequest& request, long long& answer) {
+        if (request.question == INPUT_BET) {
+            answer = BlackjackGame::MIN_BET;
+        } else if (request.question == INPUT_ACTION) {
+            for (int c = 0; c < request.decisions->count; c++) {
+                if (request.decisions->actions[c] == request.decisions->recommended) answer = c + 1;
+            }
+        } else if (request.question == INPUT_PLAY_AGAIN) {
+            // Stop while a doubled split is still covered
+            answer = roundsPlayed < sessionRounds && sessionBalance >= 4 * BlackjackGame::MIN_BET;
+        } else {
+            answer = 1;
+        }
+        return true;
+    }, [&](long long balance) {
+        roundsPlayed++;
+        sessionBalance = balance;
+    });
+
+    BasicStrategy strategy;
+    int diverged = 0;
+    for (int i = 0; i < sessions; i++) {
+        roundsPlayed = 0;
+        BlackjackGame session(true);
+        session.setHistoryLimit(0);
+        session.setSeed(CHECK_SEED + static_cast<std::uint64_t>(i));
+        session.playSession(recommended);
+
+        BlackjackGame reference(true);
+        reference.setHistoryLimit(0);
+        reference.setSeed(CHECK_SEED + static_cast<std::uint64_t>(i));
+        for (int r = 0; r < roundsPlayed; r++) {
+            reference.playAutomatedRound(strategy);
+        }
+        if (session.getBalance() != reference.getBalance() ||
+            session.getStatistics().getTotalGames() != reference.getStatistics().getTotalGames()) {
+            diverged++;
+        }
+    }
+    check("CallbackInput sessions against the simulator", diverged == 0,
+          to_string(diverged) + " of " + to_string(sessions) + " sessions diverged");
+}
+
+/* A split deals each half a second card and plays both. The first shoe
+   that deals the seat a splittable pair is found by drawing its first two
+   cards the way the table does. */
+static void checkSplit() {
+    std::uint64_t seed = CHECK_SEED;
+    for (;; seed++) {
+        CardDeck deck(seed);
+        deck.setQuiet(true);
+        Player seat;
+        seat.addCard(deck.drawCard());
+        seat.addCard(deck.drawCard());
+        if (seat.canSplit(0)) break;
+    }
+
+    string table;
+    ScriptInput input("1 10 p s s n");
+    BlackjackGame split;
+    split.setOutput(&table);
+    split.setSeed(seed);
+    split.playSession(input);
+    size_t splitAt = table.find("Player splits");
+    bool bothPlayed = splitAt != string::npos && table.find("Hand 2 dealt card", splitAt) != string::npos &&
+                      table.find("Player 1's hand 1:", splitAt) != string::npos &&
+                      table.find("Player 1's hand 2:", splitAt) != string::npos;
+    check("Split deals and plays both hands", bothPlayed && split.getStatistics().getTotalGames() == 2 &&
+          split.getTotalWagered() == 2000, "seed " + to_string(seed));
+}
+
+/* A recorded session replays cleanly; the same file with rules out of
+   bounds in its header (more decks than a shoe holds, a natural paid
+   n:0) is not a recording. */
+static void checkReplay() {
+    const string path = "regression_session.bjr";
+    remove(path.c_str());
+    {
+        ScriptInput script("1 10 * * * * y 10 * * * * n");
+        SessionRecorder recorder(script, CHECK_SEED, StandardRules::ruleSet());
+        BlackjackGame game(true);
+        game.setSeed(CHECK_SEED);
+        recorder.open(path);
+        game.playSession(recorder);
+    }
+    ifstream in(path.c_str(), ios::binary);
+    string recording((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    ostringstream report;
+    vector<string> paths(1, path);
+    check("Recorded session replays", recording.size() > 24 && replayRecordings(paths, 1, report) == 0);
+
+    const int corruptions[][2] = { { 16, 200 }, { 16, 0 }, { 17, 100 }, { 20, 0 } };    // Header byte, value
+    int accepted = 0;
+    for (const int* corruption : corruptions) {
+        string corrupt = recording;
+        corrupt[corruption[0]] = static_cast<char>(corruption[1]);
+        ofstream(path.c_str(), ios::binary | ios::trunc) << corrupt;
+        vector<RecordedSession> sessions;
+        if (readRecording(path, sessions)) accepted++;
+    }
+    check("Corrupt recording headers are rejected", accepted == 0, to_string(accepted) + " accepted");
+    remove(path.c_str());
+}
+
+int main() {
+    checkHandBatch(false);
+    checkHandBatch(true);
+    checkRuntimeRules();
+    checkDealerStrategy();
+    checkSessionsAgainstSimulator();
+    checkSplit();
+    checkReplay();
+
+    if (failures > 0) {
+        printf("%d check%s failed\n", failures, failures == 1 ? "" : "s");
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}